@@ -1,21 +1,30 @@
 #include <benchmark/benchmark.h>
 
 #include <clickhouse/client.h>
+#include <clickhouse/base/compressed.h>
+#include <clickhouse/base/varint.h>
+#include <clickhouse/base/wire_format.h>
+#include <clickhouse/columns/numeric.h>
+#include <clickhouse/columns/string.h>
 #include <ut/utils.h>
 
 namespace clickhouse {
 
-Client g_client(ClientOptions()
+// Connects on first use, so benchmarks which don't need a server run without it.
+Client& GetClient() {
+    static Client client(ClientOptions()
         .SetHost(           getEnvOrDefault("CLICKHOUSE_HOST",     "localhost"))
         .SetPort( std::stoi(getEnvOrDefault("CLICKHOUSE_PORT",     "9000")))
         .SetUser(           getEnvOrDefault("CLICKHOUSE_USER",     "default"))
         .SetPassword(       getEnvOrDefault("CLICKHOUSE_PASSWORD", ""))
         .SetDefaultDatabase(getEnvOrDefault("CLICKHOUSE_DB",       "default"))
         .SetPingBeforeQuery(false));
+    return client;
+}
 
 static void SelectNumber(benchmark::State& state) {
     while (state.KeepRunning()) {
-        g_client.Select("SELECT number, number, number FROM system.numbers LIMIT 1000",
+        GetClient().Select("SELECT number, number, number FROM system.numbers LIMIT 1000",
             [](const Block& block) { block.GetRowCount(); }
         );
     }
@@ -25,7 +34,7 @@ BENCHMARK(SelectNumber);
 static void SelectNumberMoreColumns(benchmark::State& state) {
     // Mainly test performance on type name parsing.
     while (state.KeepRunning()) {
-        g_client.Select("SELECT "
+        GetClient().Select("SELECT "
                 "number, number, number, number, number, number, number, number, number, number "
                 "FROM system.numbers LIMIT 100",
             [](const Block& block) { block.GetRowCount(); }
@@ -34,6 +43,131 @@ static void SelectNumberMoreColumns(benchmark::State& state) {
 }
 BENCHMARK(SelectNumberMoreColumns);
 
+// Columns of a small block of an insert stream, as they are compressed.
+static Buffer MakeSmallBlock(size_t n) {
+    auto ids = std::make_shared<ColumnUInt64>();
+    auto hosts = std::make_shared<ColumnString>();
+    auto paths = std::make_shared<ColumnString>();
+    for (size_t i = 0; i < 50; ++i) {
+        ids->Append(n * 50 + i);
+        hosts->Append("host-" + std::to_string((n + i) % 20) + ".example.com");
+        paths->Append("/api/v1/items/" + std::to_string((n * 31 + i * 7) % 1000) + "?format=json");
+    }
+
+    Buffer result;
+    BufferOutput output(&result);
+    ids->Save(&output);
+    hosts->Save(&output);
+    paths->Save(&output);
+    output.Flush();
+    return result;
+}
+
+static void CompressSmallBlocksZstd(benchmark::State& state) {
+    const bool use_dictionary = state.range(0);
+
+    std::vector<Buffer> blocks;
+    for (size_t n = 0; n < 1000; ++n) {
+        blocks.push_back(MakeSmallBlock(n));
+    }
+    // Trained on the first blocks of the stream.
+    const auto dictionary = use_dictionary
+        ? ZstdDictionary::Train(std::vector<Buffer>(blocks.begin(), blocks.begin() + 100), 16 * 1024)
+        : nullptr;
+
+    Buffer compressed_data;
+    size_t original_size = 0;
+    size_t compressed_size = 0;
+    for (auto _ : state) {
+        for (size_t n = 100; n < blocks.size(); ++n) {
+            compressed_data.clear();
+            BufferOutput output(&compressed_data);
+            CompressedOutput compressed(&output, 0, CompressionMethod::ZSTD);
+            compressed.SetDictionary(dictionary);
+            compressed.Write(blocks[n].data(), blocks[n].size());
+            compressed.Flush();
+
+            original_size += blocks[n].size();
+            compressed_size += compressed_data.size();
+        }
+    }
+
+    state.SetBytesProcessed(static_cast<int64_t>(original_size));
+    state.counters["ratio"] = static_cast<double>(original_size) / static_cast<double>(compressed_size);
+}
+BENCHMARK(CompressSmallBlocksZstd)->Arg(0)->Arg(1);
+
+// Hostnames and paths of 5..200 bytes, a few of them have two-byte lengths.
+static std::vector<std::string> MakeShortStrings() {
+    std::vector<std::string> result;
+    for (size_t i = 0; i < 10000; ++i) {
+        result.push_back("host-" + std::to_string(i % 20) + ".example.com/"
+            + std::string((i * 37) % 160, static_cast<char>('a' + i % 26)));
+    }
+    return result;
+}
+
+// Arg(0) goes through WireFormat string by string, Arg(1) uses the string kernels.
+static void EncodeShortStrings(benchmark::State& state) {
+    const bool use_kernels = state.range(0);
+    const auto values = MakeShortStrings();
+    const std::vector<std::string_view> items(values.begin(), values.end());
+
+    Buffer data(1024 * 1024);
+    size_t bytes = 0;
+    for (auto _ : state) {
+        ArrayOutput output(data.data(), data.size());
+        if (use_kernels) {
+            size_t encoded = 0;
+            bytes += EncodeStrings(items.data(), items.size(), data.data(), data.size(), &encoded);
+        } else {
+            for (const auto& item : items) {
+                WireFormat::WriteString(output, item);
+            }
+            bytes += output.Size();
+        }
+        benchmark::DoNotOptimize(data.data());
+    }
+
+    state.SetBytesProcessed(static_cast<int64_t>(bytes));
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * items.size()));
+}
+BENCHMARK(EncodeShortStrings)->Arg(0)->Arg(1);
+
+static void DecodeShortStrings(benchmark::State& state) {
+    const bool use_kernels = state.range(0);
+    const auto values = MakeShortStrings();
+
+    Buffer data;
+    {
+        BufferOutput output(&data);
+        for (const auto& value : values) {
+            WireFormat::WriteString(output, value);
+        }
+    }
+
+    std::vector<std::string_view> items(values.size());
+    for (auto _ : state) {
+        if (use_kernels) {
+            size_t decoded = 0;
+            DecodeStrings(data.data(), data.size(), items.data(), items.size(), &decoded);
+        } else {
+            ArrayInput input(data.data(), data.size());
+            for (auto& item : items) {
+                uint64_t len = 0;
+                WireFormat::ReadVarint64(input, &len);
+                item = std::string_view(reinterpret_cast<const char*>(input.Data()), len);
+                input.Skip(len);
+            }
+        }
+        benchmark::DoNotOptimize(items.data());
+    }
+
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * data.size()));
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * items.size()));
+}
+BENCHMARK(DecodeShortStrings)->Arg(0)->Arg(1);
+
 }
 
 BENCHMARK_MAIN();
@@ -0,0 +1,576 @@
+#include "async_client.h"
+#include "client_impl.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <system_error>
+
+#include <sys/socket.h>
+
+namespace clickhouse {
+
+namespace {
+
+/// Size of the buffer for a single recv() call.
+constexpr size_t READ_CHUNK_SIZE = 64 * 1024;
+
+/// Thrown by PacketInput when packet has not been received completely yet,
+/// not derived from std::exception to pass through any handlers of regular errors.
+struct NeedMoreData {};
+
+/**
+ * Input over the data received so far, which allows to restart parsing of a packet
+ * from its beginning once more data is received.
+ */
+class PacketInput : public ZeroCopyInput {
+public:
+    /// Number of bytes received, but not consumed by complete packets.
+    inline size_t Pending() const noexcept {
+        return end_ - begin_;
+    }
+
+    /// Whether parsing has run out of data since the last Commit() or Rollback().
+    inline bool Starved() const noexcept {
+        return starved_;
+    }
+
+    /// Number of bytes the current packet takes at least, as far as it has been parsed.
+    inline size_t Expected() const noexcept {
+        return wanted_ - begin_;
+    }
+
+    /// Marks everything read so far as consumed.
+    inline void Commit() noexcept {
+        begin_ = pos_;
+        wanted_ = pos_;
+        starved_ = false;
+    }
+
+    /// Restarts reading from the beginning of the current packet.
+    inline void Rollback() noexcept {
+        pos_ = begin_;
+        starved_ = false;
+    }
+
+    /// Returns space for at least len bytes at the end of the data, must not be called while parsing.
+    uint8_t* Reserve(size_t len) {
+        if (begin_ == end_) {
+            begin_ = pos_ = end_ = wanted_ = 0;
+        } else if (begin_ > 0 && buffer_.size() - end_ < len) {
+            memmove(buffer_.data(), buffer_.data() + begin_, end_ - begin_);
+            pos_ -= begin_;
+            end_ -= begin_;
+            wanted_ -= begin_;
+            begin_ = 0;
+        }
+
+        if (buffer_.size() - end_ < len) {
+            buffer_.resize(std::max(end_ + len, buffer_.size() * 2));
+        }
+
+        return buffer_.data() + end_;
+    }
+
+    /// Appends len bytes written to the space returned by Reserve().
+    inline void Append(size_t len) noexcept {
+        end_ += len;
+    }
+
+protected:
+    size_t DoNext(const void** ptr, size_t len) override {
+        if (pos_ == end_) {
+            // Readers ask for the exact number of bytes they need, except for the ones
+            // which take whatever is available.
+            wanted_ = std::max(wanted_, pos_ + (len == SIZE_MAX ? 1 : len));
+            starved_ = true;
+            throw NeedMoreData();
+        }
+
+        len = std::min(len, end_ - pos_);
+        *ptr = buffer_.data() + pos_;
+        pos_ += len;
+
+        return len;
+    }
+
+    void DoBackUp(size_t count) override {
+        pos_ -= count;
+    }
+
+private:
+    std::vector<uint8_t> buffer_;
+    size_t begin_ = 0;
+    size_t pos_ = 0;
+    size_t end_ = 0;
+    /// End of the data needed by the current packet so far.
+    size_t wanted_ = 0;
+    bool starved_ = false;
+};
+
+/// Accumulates outgoing data, which is sent by the event loop when socket is ready for writing.
+class SendBuffer : public ZeroCopyOutput {
+public:
+    explicit SendBuffer(std::function<void()> on_flush)
+        : on_flush_(std::move(on_flush))
+    {
+    }
+
+    inline const uint8_t* Data() const noexcept {
+        return buffer_.data() + sent_;
+    }
+
+    inline size_t Size() const noexcept {
+        return buffer_.size() - sent_;
+    }
+
+    void Consume(size_t len) noexcept {
+        sent_ += len;
+        if (sent_ == buffer_.size()) {
+            buffer_.clear();
+            sent_ = 0;
+        }
+    }
+
+protected:
+    size_t DoNext(void** data, size_t len) override {
+        const size_t pos = buffer_.size();
+        buffer_.resize(pos + len);
+        *data = buffer_.data() + pos;
+        return len;
+    }
+
+    void DoBackUp(size_t count) override {
+        buffer_.resize(buffer_.size() - count);
+    }
+
+    void DoFlush() override {
+        on_flush_();
+    }
+
+private:
+    std::vector<uint8_t> buffer_;
+    size_t sent_ = 0;
+    std::function<void()> on_flush_;
+};
+
+bool IsServerException(const std::exception_ptr& error) {
+    try {
+        std::rethrow_exception(error);
+    } catch (const ServerException&) {
+        return true;
+    } catch (...) {
+        return false;
+    }
+}
+
+std::exception_ptr SocketError(const char* what) {
+    return std::make_exception_ptr(std::system_error(errno, std::system_category(), what));
+}
+
+AsyncClient::CompletionCallback MakePromiseCallback(std::future<void>* future) {
+    auto promise = std::make_shared<std::promise<void>>();
+    *future = promise->get_future();
+
+    return [promise] (std::exception_ptr error) {
+        if (error) {
+            promise->set_exception(error);
+        } else {
+            promise->set_value();
+        }
+    };
+}
+
+}
+
+class AsyncClient::Connection : public std::enable_shared_from_this<Connection> {
+public:
+    struct Request {
+        Query query;
+        /// Data of INSERT query, sent when the server responds with the header.
+        std::optional<Block> insert_block;
+        CompletionCallback done;
+    };
+
+    Connection(EventLoop& loop, std::unique_ptr<Client::Impl> impl);
+
+    /// Starts watching the socket, called once right after construction.
+    void Start();
+
+    /// Queues request for execution, may be called from any thread.
+    void Submit(Request request);
+
+    /// Closes connection on the loop thread, may be called from any thread.
+    void Shutdown();
+
+    /// Closes connection completing all requests with the error, called on the loop thread.
+    void Close(std::exception_ptr error);
+
+    inline const ServerInfo& GetServerInfo() const noexcept {
+        return server_info_;
+    }
+
+private:
+    void Enqueue(Request request);
+    void StartNext();
+    void Finish(std::exception_ptr error);
+
+    void OnEvents(uint32_t events);
+    void ReadSocket();
+    void WriteSocket();
+    void ProcessPackets();
+    void OnPacket(uint64_t packet_type, bool has_more);
+
+private:
+    EventLoop& loop_;
+    std::unique_ptr<Client::Impl> impl_;
+    const ServerInfo server_info_;
+    const int fd_;
+    PacketInput* input_;
+    SendBuffer* output_;
+
+    std::deque<Request> queue_;
+    std::optional<Request> current_;
+    /// Set once the INSERT data has been sent.
+    bool insert_data_sent_ = false;
+
+    /** Incomplete packet is parsed again from its beginning only once the data it has run out of
+     *  is received, i.e. a whole compressed frame or column, rather than on every received chunk.
+     */
+    size_t retry_threshold_ = 0;
+
+    bool writing_ = false;
+    bool closed_ = false;
+    std::exception_ptr error_;
+};
+
+AsyncClient::Connection::Connection(EventLoop& loop, std::unique_ptr<Client::Impl> impl)
+    : loop_(loop)
+    , impl_(std::move(impl))
+    , server_info_(impl_->GetServerInfo())
+    , fd_(static_cast<int>(static_cast<Socket*>(impl_->GetSocket())->GetHandle()))
+{
+    auto input = std::make_unique<PacketInput>();
+    auto output = std::make_unique<SendBuffer>([this] { WriteSocket(); });
+
+    input_ = input.get();
+    output_ = output.get();
+
+    static_cast<Socket*>(impl_->GetSocket())->SetNonBlock(true);
+    impl_->ReplaceStreams(std::move(input), std::move(output));
+}
+
+void AsyncClient::Connection::Start() {
+    auto self = shared_from_this();
+    loop_.Post([self] {
+        self->loop_.Watch(self->fd_, EventLoop::Readable, [conn = self.get()] (uint32_t events) {
+            conn->OnEvents(events);
+        });
+    });
+}
+
+void AsyncClient::Connection::Submit(Request request) {
+    auto self = shared_from_this();
+    auto shared_request = std::make_shared<Request>(std::move(request));
+    loop_.Post([self, shared_request] {
+        self->Enqueue(std::move(*shared_request));
+    });
+}
+
+void AsyncClient::Connection::Shutdown() {
+    auto self = shared_from_this();
+    loop_.Post([self] {
+        self->Close(std::make_exception_ptr(ProtocolError("client is destroyed")));
+    });
+}
+
+void AsyncClient::Connection::Close(std::exception_ptr error) {
+    if (closed_) {
+        return;
+    }
+
+    closed_ = true;
+    error_ = error;
+
+    loop_.Unwatch(fd_);
+    impl_->events_ = nullptr;
+    impl_->column_projection_ = nullptr;
+
+    std::deque<Request> requests;
+    if (current_) {
+        requests.push_back(std::move(*current_));
+        current_.reset();
+    }
+    std::move(queue_.begin(), queue_.end(), std::back_inserter(requests));
+    queue_.clear();
+
+    // Closes the socket.
+    impl_.reset();
+
+    for (auto& request : requests) {
+        request.done(error_);
+    }
+}
+
+void AsyncClient::Connection::Enqueue(Request request) {
+    if (closed_) {
+        request.done(error_);
+        return;
+    }
+
+    queue_.push_back(std::move(request));
+    if (!current_) {
+        StartNext();
+    }
+}
+
+void AsyncClient::Connection::StartNext() {
+    if (closed_ || current_ || queue_.empty()) {
+        return;
+    }
+
+    current_.emplace(std::move(queue_.front()));
+    queue_.pop_front();
+    insert_data_sent_ = false;
+
+    impl_->events_ = &current_->query;
+    const auto& projection = current_->query.GetColumnProjection();
+    impl_->column_projection_ = projection.empty() ? nullptr : &projection;
+    try {
+        impl_->SendQuery(current_->query);
+    } catch (...) {
+        Close(std::current_exception());
+        return;
+    }
+
+    // Response may be already received, i.e. an exception for the previous query.
+    ProcessPackets();
+}
+
+void AsyncClient::Connection::Finish(std::exception_ptr error) {
+    impl_->events_ = nullptr;
+    impl_->column_projection_ = nullptr;
+    impl_->recycled_columns_.clear();
+    impl_->skipped_columns_.clear();
+
+    auto request = std::move(*current_);
+    current_.reset();
+
+    request.done(error);
+
+    StartNext();
+}
+
+void AsyncClient::Connection::OnEvents(uint32_t events) {
+    if (events & EventLoop::Writable) {
+        try {
+            WriteSocket();
+        } catch (...) {
+            Close(std::current_exception());
+            return;
+        }
+    }
+    if (!closed_ && (events & EventLoop::Readable)) {
+        ReadSocket();
+    }
+}
+
+void AsyncClient::Connection::ReadSocket() {
+    bool received = false;
+    for (;;) {
+        uint8_t* buf = input_->Reserve(READ_CHUNK_SIZE);
+        const ssize_t ret = ::recv(fd_, buf, READ_CHUNK_SIZE, 0);
+
+        if (ret > 0) {
+            input_->Append(static_cast<size_t>(ret));
+            received = true;
+            continue;
+        }
+        if (ret == 0) {
+            Close(std::make_exception_ptr(std::system_error(ECONNRESET, std::system_category(), "closed")));
+            return;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            break;
+        }
+
+        Close(SocketError("can't receive string data"));
+        return;
+    }
+
+    if (received) {
+        ProcessPackets();
+    }
+}
+
+void AsyncClient::Connection::WriteSocket() {
+    if (closed_) {
+        return;
+    }
+
+#if defined(_linux_)
+    static const int flags = MSG_NOSIGNAL;
+#else
+    static const int flags = 0;
+#endif
+
+    while (output_->Size() > 0) {
+        const ssize_t ret = ::send(fd_, output_->Data(), output_->Size(), flags);
+
+        if (ret >= 0) {
+            output_->Consume(static_cast<size_t>(ret));
+            continue;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            break;
+        }
+
+        // Called from inside of the protocol code, error is handled by the caller.
+        throw std::system_error(errno, std::system_category(), "fail to send " + std::to_string(output_->Size()) + " bytes of data");
+    }
+
+    const bool writing = output_->Size() > 0;
+    if (writing != writing_) {
+        writing_ = writing;
+        loop_.Modify(fd_, writing ? (EventLoop::Readable | EventLoop::Writable) : EventLoop::Readable);
+    }
+}
+
+void AsyncClient::Connection::ProcessPackets() {
+    while (!closed_ && current_ && input_->Pending() > 0) {
+        if (input_->Pending() < retry_threshold_) {
+            return;
+        }
+
+        uint64_t packet_type = 0;
+        bool has_more = false;
+        std::exception_ptr error;
+
+        try {
+            has_more = impl_->ReceivePacket(&packet_type);
+        } catch (...) {
+            error = std::current_exception();
+        }
+
+        // Any failure of incomplete packet is caused by the lack of data, even if reported
+        // as a regular error by the code which swallows exceptions of the input stream.
+        if (input_->Starved()) {
+            retry_threshold_ = input_->Expected();
+            input_->Rollback();
+            return;
+        }
+
+        input_->Commit();
+        retry_threshold_ = 0;
+
+        if (!error) {
+            OnPacket(packet_type, has_more);
+        } else if (IsServerException(error)) {
+            // Query is over, but connection is still usable.
+            Finish(error);
+        } else {
+            Close(error);
+        }
+    }
+}
+
+void AsyncClient::Connection::OnPacket(uint64_t packet_type, bool has_more) {
+    if (current_->insert_block && !insert_data_sent_) {
+        if (!has_more) {
+            Finish(std::make_exception_ptr(ProtocolError("fail to receive data packet")));
+            return;
+        }
+
+        if (packet_type == ServerCodes::Data) {
+            insert_data_sent_ = true;
+            try {
+                impl_->SendData(*current_->insert_block);
+                // Send empty block as marker of end of data.
+                impl_->SendData(Block());
+            } catch (...) {
+                Close(std::current_exception());
+            }
+        }
+        return;
+    }
+
+    if (!has_more) {
+        Finish(nullptr);
+    }
+}
+
+
+AsyncClient::AsyncClient(EventLoop& loop, const ClientOptions& opts)
+    : AsyncClient(loop, opts, nullptr)
+{
+}
+
+AsyncClient::AsyncClient(EventLoop& loop, const ClientOptions& opts,
+                         std::unique_ptr<SocketFactory> socket_factory)
+{
+    if (opts.ssl_options) {
+        throw UnimplementedError("AsyncClient doesn't support SSL connections");
+    }
+    if (opts.use_io_uring) {
+        throw UnimplementedError("AsyncClient doesn't support io_uring sockets");
+    }
+
+    auto impl = socket_factory
+        ? std::make_unique<Client::Impl>(opts, std::move(socket_factory))
+        : std::make_unique<Client::Impl>(opts);
+
+    if (!dynamic_cast<Socket*>(impl->GetSocket())) {
+        throw UnimplementedError("AsyncClient requires a plain TCP socket");
+    }
+
+    connection_ = std::make_shared<Connection>(loop, std::move(impl));
+    connection_->Start();
+}
+
+AsyncClient::~AsyncClient() {
+    connection_->Shutdown();
+}
+
+void AsyncClient::Execute(Query query, CompletionCallback cb) {
+    connection_->Submit(Connection::Request{std::move(query), std::nullopt, std::move(cb)});
+}
+
+std::future<void> AsyncClient::Execute(Query query) {
+    std::future<void> future;
+    Execute(std::move(query), MakePromiseCallback(&future));
+    return future;
+}
+
+void AsyncClient::Select(const std::string& query, SelectCallback cb, CompletionCallback done) {
+    Execute(Query(query).OnData(std::move(cb)), std::move(done));
+}
+
+std::future<void> AsyncClient::Select(const std::string& query, SelectCallback cb) {
+    std::future<void> future;
+    Select(query, std::move(cb), MakePromiseCallback(&future));
+    return future;
+}
+
+void AsyncClient::Insert(const std::string& table_name, const Block& block, CompletionCallback cb) {
+    connection_->Submit(Connection::Request{Query(MakeInsertQuery(table_name, block)), block, std::move(cb)});
+}
+
+std::future<void> AsyncClient::Insert(const std::string& table_name, const Block& block) {
+    std::future<void> future;
+    Insert(table_name, block, MakePromiseCallback(&future));
+    return future;
+}
+
+const ServerInfo& AsyncClient::GetServerInfo() const {
+    return connection_->GetServerInfo();
+}
+
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "client.h"
+#include "base/event_loop.h"
+
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+
+namespace clickhouse {
+
+/**
+ * Client which executes queries without blocking the calling thread.
+ *
+ * Any number of clients may share one EventLoop: protocol of each connection is driven by the loop
+ * over a non-blocking socket and packets are parsed as soon as they are received completely,
+ * so a single thread serves many concurrent queries.
+ *
+ * Connection is established in the constructor the same (blocking) way as Client does,
+ * queries submitted to one client are executed one after another in order of submission.
+ * Query events and completion callbacks are invoked on the loop thread and must not block it,
+ * i.e. never wait for a future returned by AsyncClient from the loop thread.
+ *
+ * Methods may be called from any thread. EventLoop must outlive all of its clients.
+ * SSL connections and socket timeouts are not supported.
+ */
+class AsyncClient {
+public:
+    /// Called once query is finished, error is null if query has succeeded.
+    using CompletionCallback = std::function<void(std::exception_ptr error)>;
+
+    AsyncClient(EventLoop& loop, const ClientOptions& opts);
+    AsyncClient(EventLoop& loop, const ClientOptions& opts,
+                std::unique_ptr<SocketFactory> socket_factory);
+    /// Queries which are not finished yet are completed with an error.
+    ~AsyncClient();
+
+    AsyncClient(const AsyncClient&) = delete;
+    AsyncClient& operator=(const AsyncClient&) = delete;
+
+    /// Intends for execute arbitrary queries.
+    void Execute(Query query, CompletionCallback cb);
+    std::future<void> Execute(Query query);
+
+    /// Intends for execute select queries, data is passed to \p cb on the loop thread.
+    void Select(const std::string& query, SelectCallback cb, CompletionCallback done);
+    std::future<void> Select(const std::string& query, SelectCallback cb);
+
+    /// Intends for insert block of data into a table \p table_name.
+    /// Columns of the block must not be modified until the query is finished.
+    void Insert(const std::string& table_name, const Block& block, CompletionCallback cb);
+    std::future<void> Insert(const std::string& table_name, const Block& block);
+
+    const ServerInfo& GetServerInfo() const;
+
+private:
+    class Connection;
+    std::shared_ptr<Connection> connection_;
+};
+
+}
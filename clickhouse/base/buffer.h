@@ -1,10 +1,37 @@
 #pragma once
 
 #include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
 #include <vector>
 
 namespace clickhouse {
 
 using Buffer = std::vector<uint8_t>;
 
+/// Allocator which leaves values created by resize() default-initialized, i.e. uninitialized for bytes.
+template <typename T>
+struct DefaultInitAllocator : std::allocator<T> {
+    template <typename U>
+    struct rebind {
+        using other = DefaultInitAllocator<U>;
+    };
+
+    using std::allocator<T>::allocator;
+
+    template <typename U>
+    void construct(U* ptr) {
+        ::new (static_cast<void*>(ptr)) U;
+    }
+
+    template <typename U, typename... Args>
+    void construct(U* ptr, Args&&... args) {
+        ::new (static_cast<void*>(ptr)) U(std::forward<Args>(args)...);
+    }
+};
+
+/// Buffer for data which is overwritten right away, so growing it doesn't zero the memory.
+using UninitializedBuffer = std::vector<uint8_t, DefaultInitAllocator<uint8_t>>;
+
 }
@@ -1,17 +1,29 @@
 #include "compressed.h"
 #include "wire_format.h"
 #include "output.h"
+#include "thread_pool.h"
 #include "clickhouse/exceptions.h"
 
 #include <city.h>
 #include <lz4.h>
+#include <lz4hc.h>
 #include <exception>
 #include <zstd.h>
+#include <zdict.h>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <iterator>
+#include <future>
+#include <new>
 #include <stdexcept>
 #include <system_error>
 
 namespace {
 constexpr size_t HEADER_SIZE = 9;
+// CityHash128 of the compressed frame, which precedes its header.
+constexpr size_t CHECKSUM_SIZE = 16;
 
 // see DB::CompressionMethodByte from src/Compression/CompressionInfo.h of ClickHouse project
 enum class CompressionMethodByte : uint8_t {
@@ -23,12 +35,159 @@ enum class CompressionMethodByte : uint8_t {
 // Documentation says that compression is faster when output buffer is larger than LZ4_compressBound/ZSTD_compressBound estimation.
 constexpr size_t EXTRA_COMPRESS_BUFFER_SIZE = 4096;
 constexpr size_t DBMS_MAX_COMPRESSED_SIZE = 0x40000000ULL;   // 1GB
+
+// Share of a new sample in an estimate of AdaptiveCompressionStats.
+constexpr double ESTIMATE_SMOOTHING = 0.25;
+// Each that many chunks a method is used regardless of estimates, so they follow changes of data and link.
+constexpr uint64_t PROBE_INTERVAL = 32;
 }
 
 namespace clickhouse {
 
-CompressedInput::CompressedInput(InputStream* input)
+class CompressionContext {
+public:
+    ~CompressionContext() {
+        ZSTD_freeCCtx(zstd_cctx_);
+        ZSTD_freeDCtx(zstd_dctx_);
+    }
+
+    ZSTD_CCtx* ZstdCompression() {
+        if (!zstd_cctx_ && !(zstd_cctx_ = ZSTD_createCCtx())) {
+            throw std::bad_alloc();
+        }
+        return zstd_cctx_;
+    }
+
+    ZSTD_DCtx* ZstdDecompression() {
+        if (!zstd_dctx_ && !(zstd_dctx_ = ZSTD_createDCtx())) {
+            throw std::bad_alloc();
+        }
+        return zstd_dctx_;
+    }
+
+    void* Lz4State() {
+        if (lz4_state_.empty()) {
+            lz4_state_.resize(LZ4_sizeofState());
+        }
+        return lz4_state_.data();
+    }
+
+    void* Lz4HcState() {
+        if (lz4hc_state_.empty()) {
+            lz4hc_state_.resize(LZ4_sizeofStateHC());
+        }
+        return lz4hc_state_.data();
+    }
+
+private:
+    ZSTD_CCtx* zstd_cctx_ = nullptr;
+    ZSTD_DCtx* zstd_dctx_ = nullptr;
+    UninitializedBuffer lz4_state_;
+    UninitializedBuffer lz4hc_state_;
+};
+
+void CompressionContextPool::Releaser::operator()(CompressionContext* context) const {
+    std::lock_guard<std::mutex> lock(pool->mutex_);
+    pool->free_.emplace_back(context);
+}
+
+CompressionContextPool::CompressionContextPool() = default;
+
+CompressionContextPool::~CompressionContextPool() = default;
+
+CompressionContextPool::Lease CompressionContextPool::Acquire() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!free_.empty()) {
+            Lease context(free_.back().release(), Releaser{this});
+            free_.pop_back();
+            return context;
+        }
+    }
+
+    return Lease(new CompressionContext, Releaser{this});
+}
+
+
+struct ZstdDictionary::Impl {
+    Buffer data;
+    ZSTD_CDict* cdict = nullptr;
+    ZSTD_DDict* ddict = nullptr;
+
+    ~Impl() {
+        ZSTD_freeCDict(cdict);
+        ZSTD_freeDDict(ddict);
+    }
+};
+
+ZstdDictionary::ZstdDictionary(std::unique_ptr<Impl> impl)
+    : impl_(std::move(impl))
+{
+}
+
+ZstdDictionary::~ZstdDictionary() = default;
+
+std::shared_ptr<const ZstdDictionary> ZstdDictionary::Train(const std::vector<Buffer>& samples, size_t max_size, int level) {
+    Buffer content;
+    std::vector<size_t> sizes;
+    sizes.reserve(samples.size());
+    for (const auto& sample : samples) {
+        content.insert(content.end(), sample.begin(), sample.end());
+        sizes.push_back(sample.size());
+    }
+
+    Buffer data(max_size);
+    const size_t size = ZDICT_trainFromBuffer(data.data(), data.size(), content.data(), sizes.data(), static_cast<unsigned>(sizes.size()));
+    if (ZDICT_isError(size)) {
+        throw CompressionError("Failed to train ZSTD dictionary on " + std::to_string(samples.size()) + " samples, "
+                "error: " + std::string(ZDICT_getErrorName(size)));
+    }
+    data.resize(size);
+
+    return Load(std::move(data), level);
+}
+
+std::shared_ptr<const ZstdDictionary> ZstdDictionary::Load(Buffer data, int level) {
+    auto impl = std::make_unique<Impl>();
+    impl->data = std::move(data);
+    impl->cdict = ZSTD_createCDict(impl->data.data(), impl->data.size(), level);
+    impl->ddict = ZSTD_createDDict(impl->data.data(), impl->data.size());
+    if (!impl->cdict || !impl->ddict) {
+        throw CompressionError("Failed to load ZSTD dictionary of " + std::to_string(impl->data.size()) + " bytes");
+    }
+
+    return std::shared_ptr<const ZstdDictionary>(new ZstdDictionary(std::move(impl)));
+}
+
+std::shared_ptr<const ZstdDictionary> ZstdDictionary::LoadFile(const std::string& path, int level) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        throw ValidationError("can't open ZSTD dictionary file " + path);
+    }
+
+    return Load(Buffer(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()), level);
+}
+
+const Buffer& ZstdDictionary::Data() const {
+    return impl_->data;
+}
+
+
+struct CompressedInput::Frame {
+    uint128 hash;
+    uint8_t method = 0;
+    uint32_t original = 0;
+    /// Header of the frame followed by the compressed data, as the checksum covers both.
+    UninitializedBuffer compressed;
+};
+
+CompressedInput::CompressedInput(InputStream* input, bool share_buffers, ThreadPool* pool, CompressionContextPool* contexts)
     : input_(input)
+    , share_buffers_(share_buffers)
+    , pool_(pool && pool->Size() > 0 ? pool : nullptr)
+    , own_contexts_(contexts ? nullptr : std::make_unique<CompressionContextPool>())
+    , contexts_(contexts ? contexts : own_contexts_.get())
+    , frame_(std::make_unique<Frame>())
 {
 }
 
@@ -44,6 +203,17 @@ CompressedInput::~CompressedInput() {
     }
 }
 
+std::shared_ptr<const void> CompressedInput::GetBufferOwner() const {
+    if (share_buffers_) {
+        return data_;
+    }
+    return nullptr;
+}
+
+void CompressedInput::SetDictionary(std::shared_ptr<const ZstdDictionary> dictionary) {
+    dictionary_ = std::move(dictionary);
+}
+
 size_t CompressedInput::DoNext(const void** ptr, size_t len) {
     if (mem_.Exhausted()) {
         if (!Decompress()) {
@@ -54,100 +224,339 @@ size_t CompressedInput::DoNext(const void** ptr, size_t len) {
     return mem_.Next(ptr, len);
 }
 
+size_t CompressedInput::DoRead(void* buf, size_t len) {
+    // Data left in the current frame is returned first, the caller asks for the rest again.
+    if (!mem_.Exhausted()) {
+        return ZeroCopyInput::DoRead(buf, len);
+    }
+    if (pool_) {
+        return ReadParallel(static_cast<uint8_t*>(buf), len);
+    }
+
+    Frame& frame = *frame_;
+    if (!ReadFrame(&frame)) {
+        return 0;
+    }
+
+    if (frame.original <= len) {
+        DecompressFrame(frame, static_cast<uint8_t*>(buf), *contexts_->Acquire(), dictionary_.get());
+        return frame.original;
+    }
+
+    DecompressToBuffer(frame);
+    return mem_.Read(buf, len);
+}
+
 bool CompressedInput::Decompress() {
-    uint128 hash;
+    Frame& frame = *frame_;
+    if (!ReadFrame(&frame)) {
+        return false;
+    }
+
+    DecompressToBuffer(frame);
+    return true;
+}
+
+void CompressedInput::DecompressToBuffer(const Frame& frame) {
+    // Previous chunk may still be referenced, see GetBufferOwner().
+    if (!data_ || data_.use_count() > 1) {
+        data_ = std::make_shared<UninitializedBuffer>();
+    }
+    data_->resize(frame.original);
+
+    DecompressFrame(frame, data_->data(), *contexts_->Acquire(), dictionary_.get());
+    mem_.Reset(data_->data(), frame.original);
+}
+
+size_t CompressedInput::ReadParallel(uint8_t* buf, size_t len) {
+    struct PendingFrame {
+        std::shared_ptr<Frame> frame;
+        /// Offset of the frame's data in the destination.
+        size_t offset;
+        /// Set when the frame exceeds the destination, otherwise it is decompressed right into it.
+        std::shared_ptr<UninitializedBuffer> data;
+        std::future<void> done;
+    };
+
+    std::deque<PendingFrame> pending;
+    size_t requested = 0;
+
+    auto complete_front = [&] {
+        PendingFrame front = std::move(pending.front());
+        pending.pop_front();
+        front.done.get();
+
+        if (front.data) {
+            const size_t to_copy = len - front.offset;
+            memcpy(buf + front.offset, front.data->data(), to_copy);
+
+            data_ = std::move(front.data);
+            mem_.Reset(data_->data() + to_copy, data_->size() - to_copy);
+        }
+        // The task is done with the frame, even if it hasn't released the reference yet.
+        spare_frames_.push_back(std::move(front.frame));
+    };
+
+    auto next_frame = [this] {
+        if (spare_frames_.empty()) {
+            return std::make_shared<Frame>();
+        }
+        auto frame = std::move(spare_frames_.back());
+        spare_frames_.pop_back();
+        return frame;
+    };
+
+    try {
+        // Frames are read only while the data is known to be needed, as the input goes on with other packets.
+        while (requested < len) {
+            auto frame = next_frame();
+            if (!ReadFrame(frame.get())) {
+                spare_frames_.push_back(std::move(frame));
+                break;
+            }
+
+            const size_t offset = requested;
+            requested += frame->original;
+
+            if (pending.empty() && requested >= len) {
+                // There is nothing to do meanwhile, when a single frame is needed.
+                spare_frames_.push_back(frame);
+                if (requested == len) {
+                    DecompressFrame(*frame, buf, *contexts_->Acquire(), dictionary_.get());
+                    return len;
+                }
+                DecompressToBuffer(*frame);
+                return mem_.Read(buf, len);
+            }
+
+            std::shared_ptr<UninitializedBuffer> data;
+            uint8_t* dest = buf + offset;
+            if (requested > len) {
+                // Nothing is read from data_ now, so it may be reused unless referenced by a reader.
+                data = (data_ && data_.use_count() == 1) ? std::move(data_) : std::make_shared<UninitializedBuffer>();
+                data->resize(frame->original);
+                dest = data->data();
+            }
+
+            auto done = pool_->Submit([frame, data, dest, contexts = contexts_, dictionary = dictionary_] {
+                DecompressFrame(*frame, dest, *contexts->Acquire(), dictionary.get());
+            });
+            pending.push_back(PendingFrame{std::move(frame), offset, std::move(data), std::move(done)});
+
+            if (pending.size() > pool_->Size()) {
+                complete_front();
+            }
+        }
+
+        while (!pending.empty()) {
+            complete_front();
+        }
+    } catch (...) {
+        // Tasks write into the destination, which is valid only until return.
+        for (auto& p : pending) {
+            p.done.wait();
+        }
+        throw;
+    }
+
+    return std::min(requested, len);
+}
+
+bool CompressedInput::ReadFrame(Frame* frame) {
     uint32_t compressed = 0;
-    uint32_t original = 0;
-    uint8_t method = 0;
 
-    if (!WireFormat::ReadFixed(*input_, &hash)) {
+    if (!WireFormat::ReadFixed(*input_, &frame->hash)) {
         return false;
     }
-    if (!WireFormat::ReadFixed(*input_, &method)) {
+    if (!WireFormat::ReadFixed(*input_, &frame->method)) {
         return false;
     }
 
-    if (method != static_cast<uint8_t>(CompressionMethodByte::LZ4) && method != static_cast<uint8_t>(CompressionMethodByte::ZSTD)) {
-        throw CompressionError("unsupported compression method " + std::to_string((method)));
+    if (frame->method != static_cast<uint8_t>(CompressionMethodByte::LZ4) && frame->method != static_cast<uint8_t>(CompressionMethodByte::ZSTD)
+            && frame->method != static_cast<uint8_t>(CompressionMethodByte::NONE)) {
+        throw CompressionError("unsupported compression method " + std::to_string((frame->method)));
     }
 
     if (!WireFormat::ReadFixed(*input_, &compressed)) {
         return false;
     }
-    if (!WireFormat::ReadFixed(*input_, &original)) {
+    if (!WireFormat::ReadFixed(*input_, &frame->original)) {
         return false;
     }
 
     if (compressed > DBMS_MAX_COMPRESSED_SIZE) {
         throw CompressionError("compressed data too big");
     }
+    if (compressed < HEADER_SIZE) {
+        throw CompressionError("compressed data too small");
+    }
 
-    Buffer tmp(compressed);
+    frame->compressed.resize(compressed);
 
     // Data header
     {
-        BufferOutput out(&tmp);
-        out.Write(&method, sizeof(method));
-        out.Write(&compressed, sizeof(compressed));
-        out.Write(&original, sizeof(original));
-        out.Flush();
+        auto header = frame->compressed.data();
+        WriteUnaligned(header, frame->method);
+        WriteUnaligned(header + 1, compressed);
+        WriteUnaligned(header + 5, frame->original);
     }
 
-    if (!WireFormat::ReadBytes(*input_, tmp.data() + HEADER_SIZE, compressed - HEADER_SIZE)) {
-        return false;
-    } else {
-        if (hash != CityHash128((const char*)tmp.data(), compressed)) {
-            throw CompressionError("data was corrupted");
-        }
-    }
+    return WireFormat::ReadBytes(*input_, frame->compressed.data() + HEADER_SIZE, compressed - HEADER_SIZE);
+}
 
-    data_ = Buffer(original);
+void CompressedInput::DecompressFrame(const Frame& frame, uint8_t* dest, CompressionContext& context, const ZstdDictionary* dictionary) {
+    const UninitializedBuffer& tmp = frame.compressed;
+    const size_t compressed = tmp.size();
+    const uint32_t original = frame.original;
 
-    switch (method) {
+    if (frame.hash != CityHash128((const char*)tmp.data(), compressed)) {
+        throw CompressionError("data was corrupted");
+    }
+
+    switch (frame.method) {
     case static_cast<uint8_t>(CompressionMethodByte::LZ4): {
-        if (LZ4_decompress_safe((const char*)tmp.data() + HEADER_SIZE, (char*)data_.data(), static_cast<int>(compressed - HEADER_SIZE), original) < 0) {
+        if (LZ4_decompress_safe((const char*)tmp.data() + HEADER_SIZE, (char*)dest, static_cast<int>(compressed - HEADER_SIZE), original) < 0) {
             throw CompressionError("can't decompress LZ4-encoded data");
-        } else {
-            mem_.Reset(data_.data(), original);
         }
-        return true;
+        break;
     }
 
     case static_cast<uint8_t>(CompressionMethodByte::ZSTD): {
-        size_t res = ZSTD_decompress((char*)data_.data(), original, (const char*)tmp.data() + HEADER_SIZE, static_cast<int>(compressed - HEADER_SIZE));
+        size_t res = dictionary
+            ? ZSTD_decompress_usingDDict(context.ZstdDecompression(), (char*)dest, original, (const char*)tmp.data() + HEADER_SIZE, compressed - HEADER_SIZE,
+                    dictionary->impl_->ddict)
+            : ZSTD_decompressDCtx(context.ZstdDecompression(), (char*)dest, original, (const char*)tmp.data() + HEADER_SIZE, compressed - HEADER_SIZE);
 
         if (ZSTD_isError(res)) {
             throw CompressionError("can't decompress ZSTD-encoded data, ZSTD error: " + std::string(ZSTD_getErrorName(res)));
-        } else {
-            mem_.Reset(data_.data(), original);
         }
-        return true;
+        break;
     }
 
     case static_cast<uint8_t>(CompressionMethodByte::NONE): {
-        throw CompressionError("compression method not defined" + std::to_string((method)));
+        if (compressed - HEADER_SIZE != original) {
+            throw CompressionError("size of uncompressed data doesn't match");
+        }
+        memcpy(dest, tmp.data() + HEADER_SIZE, original);
+        break;
     }
     default: {
-        throw CompressionError("Unknown or unsupported compression method " + std::to_string((method)));
+        throw CompressionError("Unknown or unsupported compression method " + std::to_string((frame.method)));
     }
     }
+}
 
-    return true;
+
+void AdaptiveCompressionStats::Estimate::Update(double sample_ratio, double sample_ns_per_byte) {
+    if (!measured) {
+        ratio = sample_ratio;
+        ns_per_byte = sample_ns_per_byte;
+        measured = true;
+    } else {
+        ratio += (sample_ratio - ratio) * ESTIMATE_SMOOTHING;
+        ns_per_byte += (sample_ns_per_byte - ns_per_byte) * ESTIMATE_SMOOTHING;
+    }
 }
 
+CompressionMethod AdaptiveCompressionStats::Choose() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++chunks_;
+
+    if (!lz4_.measured) {
+        return CompressionMethod::LZ4;
+    }
+    if (!zstd_.measured) {
+        return CompressionMethod::ZSTD;
+    }
+    if (chunks_ % PROBE_INTERVAL == 0) {
+        return (chunks_ / PROBE_INTERVAL) % 2 ? CompressionMethod::ZSTD : CompressionMethod::LZ4;
+    }
+
+    // Time to compress and send a byte of data.
+    const double none_cost = send_ns_per_byte_;
+    const double lz4_cost = lz4_.ns_per_byte + lz4_.ratio * send_ns_per_byte_;
+    const double zstd_cost = zstd_.ns_per_byte + zstd_.ratio * send_ns_per_byte_;
 
-CompressedOutput::CompressedOutput(OutputStream * destination, size_t max_compressed_chunk_size, CompressionMethod method)
+    if (none_cost <= lz4_cost && none_cost <= zstd_cost) {
+        return CompressionMethod::None;
+    }
+    return lz4_cost <= zstd_cost ? CompressionMethod::LZ4 : CompressionMethod::ZSTD;
+}
+
+void AdaptiveCompressionStats::OnCompressed(CompressionMethod method, size_t original_size, size_t compressed_size, std::chrono::nanoseconds elapsed) {
+    if (!original_size) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    Estimate& estimate = method == CompressionMethod::ZSTD ? zstd_ : lz4_;
+    estimate.Update(
+        std::min(1.0, static_cast<double>(compressed_size) / static_cast<double>(original_size)),
+        static_cast<double>(elapsed.count()) / static_cast<double>(original_size));
+}
+
+void AdaptiveCompressionStats::OnSent(size_t size, std::chrono::nanoseconds elapsed) {
+    if (!size) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    const double sample = static_cast<double>(elapsed.count()) / static_cast<double>(size);
+    send_ns_per_byte_ += (sample - send_ns_per_byte_) * ESTIMATE_SMOOTHING;
+}
+
+
+CompressedOutput::CompressedOutput(OutputStream * destination, size_t max_compressed_chunk_size, CompressionMethod method,
+        int level, ThreadPool* pool, CompressionContextPool* contexts, AdaptiveCompressionStats* stats)
     : destination_(destination)
     , max_compressed_chunk_size_(max_compressed_chunk_size)
     , method_(method)
+    , level_(level ? level : (method == CompressionMethod::LZ4HC ? LZ4HC_CLEVEL_DEFAULT : 1))
+    , pool_(max_compressed_chunk_size > 0 && pool && pool->Size() > 0 ? pool : nullptr)
+    , own_contexts_(contexts ? nullptr : std::make_unique<CompressionContextPool>())
+    , contexts_(contexts ? contexts : own_contexts_.get())
+    , context_(contexts_->Acquire())
+    , own_stats_(method == CompressionMethod::Adaptive && !stats ? std::make_unique<AdaptiveCompressionStats>() : nullptr)
+    , stats_(method == CompressionMethod::Adaptive ? (stats ? stats : own_stats_.get()) : nullptr)
 {
     PreallocateCompressBuffer(max_compressed_chunk_size);
 }
 
 CompressedOutput::~CompressedOutput() { }
 
+void CompressedOutput::SetDictionary(std::shared_ptr<const ZstdDictionary> dictionary) {
+    dictionary_ = std::move(dictionary);
+}
+
 size_t CompressedOutput::DoWrite(const void* data, size_t len) {
     const size_t original_len = len;
+
+    if (pool_) {
+        const size_t batch_size = max_compressed_chunk_size_ * (pool_->Size() + 1);
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+
+        if (!pending_.empty()) {
+            const size_t to_collect = std::min(len, batch_size - pending_.size());
+            pending_.insert(pending_.end(), bytes, bytes + to_collect);
+            bytes += to_collect;
+            len -= to_collect;
+
+            if (pending_.size() == batch_size) {
+                CompressParallel(pending_.data(), pending_.size());
+                pending_.clear();
+            }
+        }
+        // Whole batches are compressed right from the caller's data.
+        while (len >= batch_size) {
+            CompressParallel(bytes, batch_size);
+            bytes += batch_size;
+            len -= batch_size;
+        }
+        pending_.insert(pending_.end(), bytes, bytes + len);
+
+        return original_len;
+    }
+
     // what if len > max_compressed_chunk_size_ ?
     const size_t max_chunk_size = max_compressed_chunk_size_ > 0 ? max_compressed_chunk_size_ : len;
     if (max_chunk_size > max_compressed_chunk_size_) {
@@ -166,93 +575,220 @@ size_t CompressedOutput::DoWrite(const void* data, size_t len) {
 }
 
 void CompressedOutput::DoFlush() {
+    if (!pending_.empty()) {
+        CompressParallel(pending_.data(), pending_.size());
+        pending_.clear();
+    }
     destination_->Flush();
 }
 
 void CompressedOutput::Compress(const void * data, size_t len) {
-    switch (method_) {  
+    const size_t frame_size = CompressFrame(data, len, compressed_buffer_, *context_);
+    WriteFrames(&compressed_buffer_, &frame_size, 1);
+}
+
+void CompressedOutput::WriteFrames(const Buffer* frames, const size_t* sizes, size_t count) {
+    const auto start = std::chrono::steady_clock::now();
+    size_t total_size = 0;
+
+    for (size_t i = 0; i < count; ++i) {
+        WireFormat::WriteBytes(*destination_, frames[i].data(), sizes[i]);
+        total_size += sizes[i];
+    }
+    destination_->Flush();
+
+    if (stats_) {
+        stats_->OnSent(total_size, std::chrono::steady_clock::now() - start);
+    }
+}
+
+void CompressedOutput::CompressParallel(const uint8_t* data, size_t len) {
+    const size_t chunk_count = (len + max_compressed_chunk_size_ - 1) / max_compressed_chunk_size_;
+    if (frames_.size() < chunk_count) {
+        frames_.resize(chunk_count);
+    }
+
+    std::vector<size_t> frame_sizes(chunk_count);
+    auto compress_chunk = [&] (size_t i) {
+        const size_t offset = i * max_compressed_chunk_size_;
+        const size_t chunk_len = std::min(max_compressed_chunk_size_, len - offset);
+        // The calling thread has its own context.
+        frame_sizes[i] = i ? CompressFrame(data + offset, chunk_len, frames_[i], *contexts_->Acquire())
+                           : CompressFrame(data + offset, chunk_len, frames_[i], *context_);
+    };
+
+    std::vector<std::future<void>> results;
+    results.reserve(chunk_count);
+    for (size_t i = 1; i < chunk_count; ++i) {
+        results.push_back(pool_->Submit([&compress_chunk, i] { compress_chunk(i); }));
+    }
+
+    std::exception_ptr error;
+    try {
+        compress_chunk(0);
+    } catch (...) {
+        error = std::current_exception();
+    }
+    // Tasks reference the data and the frames, so all of them must finish before leaving.
+    for (auto& result : results) {
+        try {
+            result.get();
+        } catch (...) {
+            if (!error) {
+                error = std::current_exception();
+            }
+        }
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+
+    WriteFrames(frames_.data(), frame_sizes.data(), chunk_count);
+}
+
+size_t CompressedOutput::CompressFrame(const void* data, size_t len, Buffer& frame, CompressionContext& context) const {
+    const size_t bound = FrameSizeBound(len);
+    if (frame.size() < bound) {
+        frame.resize(bound);
+    }
+
+    uint8_t* const header = frame.data() + CHECKSUM_SIZE;
+    size_t compressed_size = 0;
+
+    const auto start = std::chrono::steady_clock::now();
+    const CompressionMethod method = stats_ ? stats_->Choose() : method_;
+
+    switch (method) {
     case clickhouse::CompressionMethod::LZ4: {
-        const auto compressed_size = LZ4_compress_default(
+        const auto lz4_size = LZ4_compress_fast_extState(
+                context.Lz4State(),
                 (const char*)data,
-                (char*)compressed_buffer_.data() + HEADER_SIZE,
+                (char*)header + HEADER_SIZE,
                 static_cast<int>(len),
-                static_cast<int>(compressed_buffer_.size() - HEADER_SIZE));
-        if (compressed_size <= 0)
+                static_cast<int>(frame.size() - CHECKSUM_SIZE - HEADER_SIZE),
+                1);
+        if (lz4_size <= 0)
             throw CompressionError("Failed to compress chunk of " + std::to_string(len) + " bytes, "
-                    "LZ4 error: " + std::to_string(compressed_size));
-
-        {
-            auto header = compressed_buffer_.data();
-            WriteUnaligned(header, CompressionMethodByte::LZ4);
-            // Compressed data size with header
-            WriteUnaligned(header + 1, static_cast<uint32_t>(compressed_size + HEADER_SIZE));
-            // Original data size
-            WriteUnaligned(header + 5, static_cast<uint32_t>(len));
-        }
+                    "LZ4 error: " + std::to_string(lz4_size));
 
-        WireFormat::WriteFixed(*destination_, CityHash128((const char*)compressed_buffer_.data(), compressed_size + HEADER_SIZE));
-        WireFormat::WriteBytes(*destination_, compressed_buffer_.data(), compressed_size + HEADER_SIZE);
+        compressed_size = static_cast<size_t>(lz4_size);
+        WriteUnaligned(header, CompressionMethodByte::LZ4);
         break;
     }
 
-    case clickhouse::CompressionMethod::ZSTD: {
-        const size_t compressed_size = ZSTD_compress(
-                (char*)compressed_buffer_.data() + HEADER_SIZE,
-                static_cast<int>(compressed_buffer_.size() - HEADER_SIZE),
+    case clickhouse::CompressionMethod::LZ4HC: {
+        const auto lz4_size = LZ4_compress_HC_extStateHC(
+                context.Lz4HcState(),
                 (const char*)data,
+                (char*)header + HEADER_SIZE,
                 static_cast<int>(len),
-                ZSTD_fast);
-        if (ZSTD_isError(compressed_size))
+                static_cast<int>(frame.size() - CHECKSUM_SIZE - HEADER_SIZE),
+                level_);
+        if (lz4_size <= 0)
             throw CompressionError("Failed to compress chunk of " + std::to_string(len) + " bytes, "
-                    "ZSTD error: " + std::string(ZSTD_getErrorName(compressed_size)));
+                    "LZ4HC error: " + std::to_string(lz4_size));
+
+        // Decompressed the same way as LZ4.
+        compressed_size = static_cast<size_t>(lz4_size);
+        WriteUnaligned(header, CompressionMethodByte::LZ4);
+        break;
+    }
 
-        {
-            auto header = compressed_buffer_.data();
-            WriteUnaligned(header, CompressionMethodByte::ZSTD);
-            // Compressed data size with header
-            WriteUnaligned(header + 1, static_cast<uint32_t>(compressed_size + HEADER_SIZE));
-            // Original data size
-            WriteUnaligned(header + 5, static_cast<uint32_t>(len));
+    case clickhouse::CompressionMethod::ZSTD: {
+        if (dictionary_) {
+            compressed_size = ZSTD_compress_usingCDict(
+                    context.ZstdCompression(),
+                    (char*)header + HEADER_SIZE,
+                    frame.size() - CHECKSUM_SIZE - HEADER_SIZE,
+                    (const char*)data,
+                    len,
+                    dictionary_->impl_->cdict);
+        } else {
+            compressed_size = ZSTD_compressCCtx(
+                    context.ZstdCompression(),
+                    (char*)header + HEADER_SIZE,
+                    frame.size() - CHECKSUM_SIZE - HEADER_SIZE,
+                    (const char*)data,
+                    len,
+                    level_);
         }
+        if (ZSTD_isError(compressed_size))
+            throw CompressionError("Failed to compress chunk of " + std::to_string(len) + " bytes, "
+                    "ZSTD error: " + std::string(ZSTD_getErrorName(compressed_size)));
 
-        WireFormat::WriteFixed(*destination_, CityHash128((const char*)compressed_buffer_.data(), compressed_size + HEADER_SIZE));
-        WireFormat::WriteBytes(*destination_, compressed_buffer_.data(), compressed_size + HEADER_SIZE);
+        WriteUnaligned(header, CompressionMethodByte::ZSTD);
         break;
     }
 
-    case clickhouse::CompressionMethod::None: {
-        throw CompressionError("no compression defined");
+    case clickhouse::CompressionMethod::None:
+    case clickhouse::CompressionMethod::Adaptive: {
+        if (!stats_) {
+            throw CompressionError("no compression defined");
+        }
+        break;
     }
     }
 
-    destination_->Flush();
+    if (stats_) {
+        if (method != CompressionMethod::None) {
+            stats_->OnCompressed(method, len, compressed_size, std::chrono::steady_clock::now() - start);
+        }
+        if (method == CompressionMethod::None || compressed_size >= len) {
+            memcpy(header + HEADER_SIZE, data, len);
+            compressed_size = len;
+            WriteUnaligned(header, CompressionMethodByte::NONE);
+        }
+    }
+
+    // Compressed data size with header
+    WriteUnaligned(header + 1, static_cast<uint32_t>(compressed_size + HEADER_SIZE));
+    // Original data size
+    WriteUnaligned(header + 5, static_cast<uint32_t>(len));
+
+    WriteUnaligned(frame.data(), CityHash128((const char*)header, compressed_size + HEADER_SIZE));
+
+    return CHECKSUM_SIZE + HEADER_SIZE + compressed_size;
 }
 
-void CompressedOutput::PreallocateCompressBuffer(size_t input_size) {
-    switch (method_) {  
-    case clickhouse::CompressionMethod::LZ4: {
+size_t CompressedOutput::FrameSizeBound(size_t input_size) const {
+    switch (method_) {
+    case clickhouse::CompressionMethod::LZ4:
+    case clickhouse::CompressionMethod::LZ4HC: {
         const auto estimated_compressed_buffer_size = LZ4_compressBound(static_cast<int>(input_size));
         if (estimated_compressed_buffer_size <= 0)
             throw CompressionError("Failed to estimate compressed buffer size, LZ4 error: " + std::to_string(estimated_compressed_buffer_size));
 
-        compressed_buffer_.resize(estimated_compressed_buffer_size + HEADER_SIZE + EXTRA_COMPRESS_BUFFER_SIZE);
-        break;
+        return estimated_compressed_buffer_size + CHECKSUM_SIZE + HEADER_SIZE + EXTRA_COMPRESS_BUFFER_SIZE;
     }
 
     case clickhouse::CompressionMethod::ZSTD: {
-        const size_t estimated_compressed_buffer_size = ZSTD_compressBound(static_cast<int>(input_size));
+        const size_t estimated_compressed_buffer_size = ZSTD_compressBound(input_size);
         if (ZSTD_isError(estimated_compressed_buffer_size))
             throw CompressionError("Failed to estimate compressed buffer size, ZSTD error: " + std::string(ZSTD_getErrorName(estimated_compressed_buffer_size)));
 
-        compressed_buffer_.resize(estimated_compressed_buffer_size + HEADER_SIZE + EXTRA_COMPRESS_BUFFER_SIZE);
-        break;
+        return estimated_compressed_buffer_size + CHECKSUM_SIZE + HEADER_SIZE + EXTRA_COMPRESS_BUFFER_SIZE;
+    }
+
+    case clickhouse::CompressionMethod::Adaptive: {
+        // Enough for any of the methods, as well as for uncompressed data.
+        const auto lz4_size = LZ4_compressBound(static_cast<int>(input_size));
+        const size_t zstd_size = ZSTD_compressBound(input_size);
+        if (lz4_size <= 0 || ZSTD_isError(zstd_size))
+            throw CompressionError("Failed to estimate compressed buffer size of " + std::to_string(input_size) + " bytes");
+
+        return std::max<size_t>(lz4_size, zstd_size) + CHECKSUM_SIZE + HEADER_SIZE + EXTRA_COMPRESS_BUFFER_SIZE;
     }
 
     case clickhouse::CompressionMethod::None: {
-        /// do nothing
         break;
     }
     }
+
+    return 0;
+}
+
+void CompressedOutput::PreallocateCompressBuffer(size_t input_size) {
+    compressed_buffer_.resize(FrameSizeBound(input_size));
 }
 
 }
@@ -6,36 +6,195 @@
 
 #include "clickhouse/client.h"
 
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
 namespace clickhouse {
 
+class ThreadPool;
+class CompressionContext;
+
+/**
+ * Compression and decompression states (ZSTD contexts, LZ4 states), which are kept for the lifetime
+ * of a connection instead of being created for each frame. A context is used by one thread at a time,
+ * so the pool creates another one when all of them are taken.
+ */
+class CompressionContextPool {
+public:
+    struct Releaser {
+        CompressionContextPool* pool;
+        void operator()(CompressionContext* context) const;
+    };
+    /// Context which returns to the pool when destroyed, the pool must outlive it.
+    using Lease = std::unique_ptr<CompressionContext, Releaser>;
+
+    CompressionContextPool();
+    ~CompressionContextPool();
+
+    Lease Acquire();
+
+private:
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<CompressionContext>> free_;
+};
+
+/**
+ * ZSTD dictionary, with which frames of small and similar chunks, e.g. of a stream of alike blocks,
+ * compress better and faster than independently.
+ *
+ * The server decompresses frames without a dictionary, so it's only for data the client reads back
+ * itself, like spool files of blocks, and is never used by the Client.
+ */
+class ZstdDictionary {
+public:
+    /** Trains a dictionary of at most \p max_size bytes on samples, which should look like chunks
+     *  to be compressed, e.g. serialized first blocks of a stream. ZSTD needs at least several dozens of them.
+     *  Chunks are compressed with the dictionary at \p level.
+     */
+    static std::shared_ptr<const ZstdDictionary> Train(const std::vector<Buffer>& samples, size_t max_size = 64 * 1024, int level = 1);
+
+    /// Dictionary previously obtained by Data().
+    static std::shared_ptr<const ZstdDictionary> Load(Buffer data, int level = 1);
+    static std::shared_ptr<const ZstdDictionary> LoadFile(const std::string& path, int level = 1);
+
+    ~ZstdDictionary();
+
+    /// Content of the dictionary, to be stored along with the data compressed with it.
+    const Buffer& Data() const;
+
+private:
+    struct Impl;
+    explicit ZstdDictionary(std::unique_ptr<Impl> impl);
+
+    friend class CompressedInput;
+    friend class CompressedOutput;
+
+    std::unique_ptr<Impl> impl_;
+};
+
+/**
+ * Reads data compressed by frames.
+ *
+ * Frames which are entirely covered by a read are decompressed right into the destination.
+ * If \p pool is given, a read of more data than is left in the current frame reads ahead all the frames
+ * it needs, which are verified and decompressed by the pool while the following ones are received.
+ */
 class CompressedInput : public ZeroCopyInput {
 public:
-    explicit CompressedInput(InputStream* input);
+    /// If \p share_buffers is set, decompressed chunks are exposed by GetBufferOwner(),
+    /// so data read from the stream may be referenced instead of being copied.
+    explicit CompressedInput(InputStream* input, bool share_buffers = false, ThreadPool* pool = nullptr,
+            CompressionContextPool* contexts = nullptr);
     ~CompressedInput() override;
 
+    std::shared_ptr<const void> GetBufferOwner() const override;
+
+    /// Dictionary which ZSTD frames have been compressed with.
+    void SetDictionary(std::shared_ptr<const ZstdDictionary> dictionary);
+
 protected:
     size_t DoNext(const void** ptr, size_t len) override;
+    size_t DoRead(void* buf, size_t len) override;
+
+    void DoBackUp(size_t count) override {
+        mem_.BackUp(count);
+    }
 
     bool Decompress();
 
+private:
+    struct Frame;
+
+    /// Reads header and compressed data of the next frame, returns false if the input has ended.
+    bool ReadFrame(Frame* frame);
+    /// Verifies checksum of the frame and decompresses it into \p dest.
+    static void DecompressFrame(const Frame& frame, uint8_t* dest, CompressionContext& context, const ZstdDictionary* dictionary);
+    /// Decompresses the frame into data_, which is then read by mem_.
+    void DecompressToBuffer(const Frame& frame);
+    size_t ReadParallel(uint8_t* buf, size_t len);
+
 private:
     InputStream* const input_;
+    const bool share_buffers_;
+    ThreadPool* const pool_;
+    std::unique_ptr<CompressionContextPool> own_contexts_;
+    CompressionContextPool* const contexts_;
+    std::shared_ptr<const ZstdDictionary> dictionary_;
 
-    Buffer data_;
+    /// Frame read by the calling thread, its buffer is reused for the next frames.
+    std::unique_ptr<Frame> frame_;
+    /// Frames which have been decompressed by the pool and may be reused.
+    std::vector<std::shared_ptr<Frame>> spare_frames_;
+
+    /// Decompressed data of the current frame, reused unless referenced by a reader, see GetBufferOwner().
+    std::shared_ptr<UninitializedBuffer> data_;
     ArrayInput mem_;
 };
 
+/**
+ * Estimates of compression ratio and speed of the methods and of the speed of sending data,
+ * by which CompressionMethod::Adaptive chooses the method minimizing time to compress and send a chunk.
+ * Thread-safe, kept for the lifetime of a connection.
+ */
+class AdaptiveCompressionStats {
+public:
+    /// Method for the next chunk: LZ4, ZSTD or None.
+    CompressionMethod Choose();
+
+    void OnCompressed(CompressionMethod method, size_t original_size, size_t compressed_size, std::chrono::nanoseconds elapsed);
+    void OnSent(size_t size, std::chrono::nanoseconds elapsed);
+
+private:
+    struct Estimate {
+        double ratio = 1.0;
+        double ns_per_byte = 0.0;
+        bool measured = false;
+
+        void Update(double sample_ratio, double sample_ns_per_byte);
+    };
+
+    std::mutex mutex_;
+    Estimate lz4_;
+    Estimate zstd_;
+    double send_ns_per_byte_ = 0.0;
+    uint64_t chunks_ = 0;
+};
+
+/**
+ * Splits data into chunks of \p max_compressed_chunk_size and writes each of them as a compressed frame.
+ *
+ * If \p pool is given and chunk size is not zero, data is collected until there is a chunk for
+ * each thread of the pool and the calling one. Then the chunks are compressed concurrently and
+ * written in order. Collected data is written by Flush(), but not by destructor.
+ *
+ * \p level of 0 means the default one of the method, it's ignored by LZ4.
+ * With CompressionMethod::Adaptive the method is chosen for each chunk by \p stats, and chunks
+ * which don't get smaller are sent uncompressed.
+ */
 class CompressedOutput : public OutputStream {
 public:
-    explicit CompressedOutput(OutputStream* destination, size_t max_compressed_chunk_size = 0, CompressionMethod method = CompressionMethod::LZ4);
+    explicit CompressedOutput(OutputStream* destination, size_t max_compressed_chunk_size = 0, CompressionMethod method = CompressionMethod::LZ4,
+            int level = 0, ThreadPool* pool = nullptr, CompressionContextPool* contexts = nullptr,
+            AdaptiveCompressionStats* stats = nullptr);
     ~CompressedOutput() override;
 
+    /// Compresses ZSTD frames with the dictionary at its level, see ZstdDictionary.
+    void SetDictionary(std::shared_ptr<const ZstdDictionary> dictionary);
+
 protected:
     size_t DoWrite(const void* data, size_t len) override;
     void DoFlush() override;
 
 private:
     void Compress(const void * data, size_t len);
+    void WriteFrames(const Buffer* frames, const size_t* sizes, size_t count);
+    void CompressParallel(const uint8_t* data, size_t len);
+    /// Puts checksum, header and compressed data into \p frame, returns size of the whole frame.
+    size_t CompressFrame(const void* data, size_t len, Buffer& frame, CompressionContext& context) const;
+    size_t FrameSizeBound(size_t input_size) const;
     void PreallocateCompressBuffer(size_t input_size);
 
 private:
@@ -43,6 +202,20 @@ private:
     const size_t max_compressed_chunk_size_;
     Buffer compressed_buffer_;
     CompressionMethod method_;
+    const int level_;
+
+    ThreadPool* const pool_;
+    std::unique_ptr<CompressionContextPool> own_contexts_;
+    CompressionContextPool* const contexts_;
+    /// Context of the calling thread.
+    CompressionContextPool::Lease context_;
+    std::shared_ptr<const ZstdDictionary> dictionary_;
+    /// Set for CompressionMethod::Adaptive only.
+    std::unique_ptr<AdaptiveCompressionStats> own_stats_;
+    AdaptiveCompressionStats* const stats_;
+    /// Data collected for concurrent compression.
+    Buffer pending_;
+    std::vector<Buffer> frames_;
 };
 
 }
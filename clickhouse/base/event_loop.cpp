@@ -0,0 +1,304 @@
+#include "event_loop.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <system_error>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#if defined(_linux_)
+#   include <sys/epoll.h>
+#   include <sys/eventfd.h>
+#endif
+
+namespace clickhouse {
+
+namespace {
+
+[[noreturn]] void ThrowSystemError(const char* what) {
+    throw std::system_error(errno, std::system_category(), what);
+}
+
+#if defined(_linux_)
+
+uint32_t ToEpollEvents(uint32_t events) {
+    return ((events & EventLoop::Readable) ? EPOLLIN : 0u)
+         | ((events & EventLoop::Writable) ? EPOLLOUT : 0u);
+}
+
+uint32_t FromEpollEvents(uint32_t events) {
+    return ((events & (EPOLLIN | EPOLLERR | EPOLLHUP | EPOLLRDHUP)) ? EventLoop::Readable : 0u)
+         | ((events & EPOLLOUT) ? EventLoop::Writable : 0u);
+}
+
+#else
+
+short ToPollEvents(uint32_t events) {
+    return ((events & EventLoop::Readable) ? POLLIN : 0)
+         | ((events & EventLoop::Writable) ? POLLOUT : 0);
+}
+
+uint32_t FromPollEvents(short events) {
+    return ((events & (POLLIN | POLLERR | POLLHUP | POLLNVAL)) ? EventLoop::Readable : 0u)
+         | ((events & POLLOUT) ? EventLoop::Writable : 0u);
+}
+
+#endif
+
+}
+
+EventLoop::EventLoop() {
+#if defined(_linux_)
+    poller_ = epoll_create1(EPOLL_CLOEXEC);
+    if (poller_ == -1) {
+        ThrowSystemError("fail to create epoll instance");
+    }
+
+    wakeup_read_ = wakeup_write_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (wakeup_read_ == -1) {
+        close(poller_);
+        ThrowSystemError("fail to create eventfd");
+    }
+
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = wakeup_read_;
+    if (epoll_ctl(poller_, EPOLL_CTL_ADD, wakeup_read_, &ev) == -1) {
+        close(wakeup_read_);
+        close(poller_);
+        ThrowSystemError("fail to watch eventfd");
+    }
+#else
+    int fds[2];
+    if (pipe(fds) == -1) {
+        ThrowSystemError("fail to create pipe");
+    }
+    for (int fd : fds) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+    wakeup_read_ = fds[0];
+    wakeup_write_ = fds[1];
+#endif
+}
+
+EventLoop::~EventLoop() {
+    // Tasks may hold resources which have to be released on the loop, i.e. connections to close.
+    while (RunPostedTasks()) {
+        ;
+    }
+
+    if (wakeup_write_ != wakeup_read_) {
+        close(wakeup_write_);
+    }
+    close(wakeup_read_);
+    if (poller_ != -1) {
+        close(poller_);
+    }
+}
+
+void EventLoop::Run() {
+    while (!stopped_) {
+        RunOnce(std::chrono::milliseconds(-1));
+    }
+    stopped_ = false;
+}
+
+size_t EventLoop::RunOnce(std::chrono::milliseconds timeout) {
+    loop_thread_ = std::this_thread::get_id();
+
+    int timeout_ms = timeout.count() < 0 ? -1 : static_cast<int>(timeout.count());
+    if (!timers_.empty()) {
+        const auto until = std::chrono::ceil<std::chrono::milliseconds>(timers_.top().deadline - std::chrono::steady_clock::now());
+        const int until_ms = static_cast<int>(std::max<int64_t>(0, until.count()));
+        timeout_ms = timeout_ms < 0 ? until_ms : std::min(timeout_ms, until_ms);
+    }
+    {
+        std::lock_guard<std::mutex> lock(tasks_mutex_);
+        if (!tasks_.empty()) {
+            timeout_ms = 0;
+        }
+    }
+
+    std::vector<std::pair<int, uint32_t>> ready;
+    Wait(timeout_ms, ready);
+
+    size_t dispatched = 0;
+    for (const auto& [fd, events] : ready) {
+        if (fd == wakeup_read_) {
+            DrainWakeup();
+            continue;
+        }
+
+        auto it = watchers_.find(fd);
+        if (it == watchers_.end()) {
+            continue;
+        }
+
+        // Handler may unwatch its own descriptor.
+        const auto watcher = it->second;
+        watcher->handler(events);
+        ++dispatched;
+    }
+
+    dispatched += RunExpiredTimers();
+    dispatched += RunPostedTasks();
+
+    return dispatched;
+}
+
+void EventLoop::Stop() {
+    stopped_ = true;
+    Wakeup();
+}
+
+void EventLoop::Post(Task task) {
+    bool was_empty;
+    {
+        std::lock_guard<std::mutex> lock(tasks_mutex_);
+        was_empty = tasks_.empty();
+        tasks_.push_back(std::move(task));
+    }
+
+    if (was_empty) {
+        Wakeup();
+    }
+}
+
+void EventLoop::Schedule(std::chrono::milliseconds delay, Task task) {
+    timers_.push(Timer{std::chrono::steady_clock::now() + delay, timer_sequence_++, std::move(task)});
+}
+
+void EventLoop::Watch(int fd, uint32_t events, IoHandler handler) {
+#if defined(_linux_)
+    epoll_event ev{};
+    ev.events = ToEpollEvents(events);
+    ev.data.fd = fd;
+    if (epoll_ctl(poller_, EPOLL_CTL_ADD, fd, &ev) == -1) {
+        ThrowSystemError("fail to watch socket");
+    }
+#endif
+
+    watchers_[fd] = std::make_shared<Watcher>(Watcher{events, std::move(handler)});
+}
+
+void EventLoop::Modify(int fd, uint32_t events) {
+    auto it = watchers_.find(fd);
+    if (it == watchers_.end() || it->second->events == events) {
+        return;
+    }
+
+#if defined(_linux_)
+    epoll_event ev{};
+    ev.events = ToEpollEvents(events);
+    ev.data.fd = fd;
+    if (epoll_ctl(poller_, EPOLL_CTL_MOD, fd, &ev) == -1) {
+        ThrowSystemError("fail to modify watched socket");
+    }
+#endif
+
+    it->second->events = events;
+}
+
+void EventLoop::Unwatch(int fd) {
+    if (watchers_.erase(fd) == 0) {
+        return;
+    }
+
+#if defined(_linux_)
+    epoll_ctl(poller_, EPOLL_CTL_DEL, fd, nullptr);
+#endif
+}
+
+bool EventLoop::InLoopThread() const {
+    return loop_thread_ == std::this_thread::get_id();
+}
+
+size_t EventLoop::Wait(int timeout_ms, std::vector<std::pair<int, uint32_t>>& ready) {
+#if defined(_linux_)
+    epoll_event events[64];
+    const int n = epoll_wait(poller_, events, 64, timeout_ms);
+    if (n == -1) {
+        if (errno == EINTR) {
+            return 0;
+        }
+        ThrowSystemError("fail to wait for events");
+    }
+
+    for (int i = 0; i < n; ++i) {
+        ready.emplace_back(static_cast<int>(events[i].data.fd), FromEpollEvents(events[i].events));
+    }
+#else
+    std::vector<pollfd> fds;
+    fds.reserve(watchers_.size() + 1);
+    fds.push_back(pollfd{wakeup_read_, POLLIN, 0});
+    for (const auto& [fd, watcher] : watchers_) {
+        fds.push_back(pollfd{fd, ToPollEvents(watcher->events), 0});
+    }
+
+    const int n = poll(fds.data(), static_cast<nfds_t>(fds.size()), timeout_ms);
+    if (n == -1) {
+        if (errno == EINTR) {
+            return 0;
+        }
+        ThrowSystemError("fail to wait for events");
+    }
+
+    for (const auto& fd : fds) {
+        if (fd.revents) {
+            ready.emplace_back(fd.fd, FromPollEvents(fd.revents));
+        }
+    }
+#endif
+
+    return ready.size();
+}
+
+size_t EventLoop::RunPostedTasks() {
+    std::vector<Task> tasks;
+    {
+        std::lock_guard<std::mutex> lock(tasks_mutex_);
+        tasks.swap(tasks_);
+    }
+
+    for (auto& task : tasks) {
+        task();
+    }
+
+    return tasks.size();
+}
+
+size_t EventLoop::RunExpiredTimers() {
+    const auto now = std::chrono::steady_clock::now();
+
+    size_t count = 0;
+    while (!timers_.empty() && timers_.top().deadline <= now) {
+        Task task = timers_.top().task;
+        timers_.pop();
+        task();
+        ++count;
+    }
+
+    return count;
+}
+
+void EventLoop::Wakeup() {
+#if defined(_linux_)
+    const uint64_t value = 1;
+#else
+    const uint8_t value = 1;
+#endif
+    // Failure means that the counter/pipe is full, so the loop is going to wake up anyway.
+    [[maybe_unused]] const auto ret = write(wakeup_write_, &value, sizeof(value));
+}
+
+void EventLoop::DrainWakeup() {
+    uint8_t buf[64];
+    while (read(wakeup_read_, buf, sizeof(buf)) > 0) {
+        ;
+    }
+}
+
+}
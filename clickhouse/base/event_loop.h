@@ -0,0 +1,107 @@
+#pragma once
+
+#include "platform.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace clickhouse {
+
+/**
+ * Single-threaded reactor, which dispatches readiness of file descriptors, timers and posted tasks.
+ * Uses epoll on Linux and poll() on other unix systems.
+ *
+ * All handlers are invoked on the thread which runs the loop,
+ * Post() and Stop() may be called from any thread.
+ */
+class EventLoop {
+public:
+    enum Event : uint32_t {
+        Readable = 1,
+        Writable = 2,
+    };
+
+    /// Receives a combination of Event flags, errors and hang-ups are reported as Readable.
+    using IoHandler = std::function<void(uint32_t events)>;
+    using Task = std::function<void()>;
+
+    EventLoop();
+    /// Executes tasks posted, but not executed yet.
+    ~EventLoop();
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    /// Runs the loop until Stop() is called.
+    void Run();
+
+    /** Runs single iteration of the loop: waits for events up to timeout (negative value means infinity)
+     *  and dispatches them. Returns number of dispatched events, tasks and timers.
+     */
+    size_t RunOnce(std::chrono::milliseconds timeout);
+
+    /// Makes Run() return after current iteration.
+    void Stop();
+
+    /// Queues task to be executed on the loop thread.
+    void Post(Task task);
+
+    /// Executes task on the loop thread after delay, must be called from the loop thread.
+    void Schedule(std::chrono::milliseconds delay, Task task);
+
+    /// Starts watching for events of fd, must be called from the loop thread as well as Modify() and Unwatch().
+    void Watch(int fd, uint32_t events, IoHandler handler);
+    void Modify(int fd, uint32_t events);
+    void Unwatch(int fd);
+
+    /// Whether the caller is running on the loop thread.
+    bool InLoopThread() const;
+
+private:
+    struct Watcher {
+        uint32_t events;
+        IoHandler handler;
+    };
+
+    struct Timer {
+        std::chrono::steady_clock::time_point deadline;
+        uint64_t sequence;
+        Task task;
+
+        bool operator>(const Timer& other) const {
+            return deadline > other.deadline || (deadline == other.deadline && sequence > other.sequence);
+        }
+    };
+
+    size_t Wait(int timeout_ms, std::vector<std::pair<int, uint32_t>>& ready);
+    size_t RunPostedTasks();
+    size_t RunExpiredTimers();
+    void Wakeup();
+    void DrainWakeup();
+
+private:
+    int poller_ = -1;
+    int wakeup_read_ = -1;
+    int wakeup_write_ = -1;
+
+    std::unordered_map<int, std::shared_ptr<Watcher>> watchers_;
+
+    std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers_;
+    uint64_t timer_sequence_ = 0;
+
+    std::mutex tasks_mutex_;
+    std::vector<Task> tasks_;
+
+    std::atomic<bool> stopped_{false};
+    std::atomic<std::thread::id> loop_thread_{};
+};
+
+}
@@ -56,10 +56,12 @@ size_t ArrayInput::DoNext(const void** ptr, size_t len) {
 }
 
 
-BufferedInput::BufferedInput(std::unique_ptr<InputStream> source, size_t buflen)
+BufferedInput::BufferedInput(std::unique_ptr<InputStream> source, size_t buflen, size_t max_buflen)
     : source_(std::move(source))
     , array_input_(nullptr, 0)
     , buffer_(buflen)
+    , min_buflen_(buflen)
+    , max_buflen_(std::max(buflen, max_buflen))
 {
 }
 
@@ -71,9 +73,7 @@ void BufferedInput::Reset() {
 
 size_t BufferedInput::DoNext(const void** ptr, size_t len)  {
     if (array_input_.Exhausted()) {
-        array_input_.Reset(
-            buffer_.data(), source_->Read(buffer_.data(), buffer_.size())
-        );
+        Refill();
     }
 
     return array_input_.Next(ptr, len);
@@ -85,12 +85,47 @@ size_t BufferedInput::DoRead(void* buf, size_t len) {
             return source_->Read(buf, len);
         }
 
-        array_input_.Reset(
-            buffer_.data(), source_->Read(buffer_.data(), buffer_.size())
-        );
+        Refill();
     }
 
     return array_input_.Read(buf, len);
 }
 
+void BufferedInput::ShrinkIfIdle() {
+    if (buffer_.size() <= min_buflen_ || !array_input_.Exhausted()) {
+        return;
+    }
+
+    std::vector<uint8_t>(min_buflen_).swap(buffer_);
+    array_input_.Reset(nullptr, 0);
+    last_read_ = 0;
+    small_reads_ = 0;
+}
+
+void BufferedInput::Refill() {
+    static constexpr size_t SMALL_READS_TO_SHRINK = 2;
+
+    // Data of the buffer is consumed, so it may be reallocated without copying.
+    if (last_read_ == buffer_.size() && buffer_.size() < max_buflen_) {
+        // There is likely more data in the source than the buffer could take.
+        std::vector<uint8_t>(std::min(buffer_.size() * 2, max_buflen_)).swap(buffer_);
+    }
+
+    last_read_ = source_->Read(buffer_.data(), buffer_.size());
+
+    if (buffer_.size() > min_buflen_) {
+        small_reads_ = (last_read_ <= min_buflen_) ? small_reads_ + 1 : 0;
+
+        if (small_reads_ >= SMALL_READS_TO_SHRINK) {
+            // Data doesn't arrive in bulk anymore, e.g. the connection becomes idle.
+            std::vector<uint8_t> buffer(min_buflen_);
+            memcpy(buffer.data(), buffer_.data(), last_read_);
+            buffer_.swap(buffer);
+            small_reads_ = 0;
+        }
+    }
+
+    array_input_.Reset(buffer_.data(), last_read_);
+}
+
 }
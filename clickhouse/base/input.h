@@ -36,10 +36,22 @@ public:
         return DoNext(buf, len);
     }
 
+    /// Returns last \p count bytes obtained by the last call of Next() to the stream, so they are read again.
+    inline void BackUp(size_t count) {
+        DoBackUp(count);
+    }
+
     bool Skip(size_t bytes) override;
 
+    /// Returns owner of the memory returned by the last call of Next(), which keeps the memory
+    /// valid after the stream has moved on, or null if the stream reuses the memory.
+    virtual std::shared_ptr<const void> GetBufferOwner() const {
+        return nullptr;
+    }
+
 protected:
     virtual size_t DoNext(const void** ptr, size_t len) = 0;
+    virtual void DoBackUp(size_t count) = 0;
 
     size_t DoRead(void* buf, size_t len) override;
 };
@@ -77,27 +89,60 @@ public:
 private:
     size_t DoNext(const void** ptr, size_t len) override;
 
+    void DoBackUp(size_t count) override {
+        data_ -= count;
+        len_ += count;
+    }
+
 private:
     const uint8_t* data_;
     size_t len_;
 };
 
 
+/**
+ * Reads data from the source by pieces of the buffer size.
+ *
+ * If \p max_buflen is greater than \p buflen, the buffer is doubled each time the source
+ * fills it completely, up to \p max_buflen, and is returned to \p buflen after a few reads
+ * which would have fit into \p buflen, or by ShrinkIfIdle().
+ */
 class BufferedInput : public ZeroCopyInput {
 public:
-    BufferedInput(std::unique_ptr<InputStream> source, size_t buflen = 8192);
+    BufferedInput(std::unique_ptr<InputStream> source, size_t buflen = 8192, size_t max_buflen = 0);
     ~BufferedInput() override;
 
     void Reset();
 
+    size_t BufferSize() const {
+        return buffer_.size();
+    }
+
+    /// Returns the grown buffer to the initial size if all data of it is consumed,
+    /// i.e. at the end of a response, after which the source may stay idle for long.
+    void ShrinkIfIdle();
+
 protected:
     size_t DoRead(void* buf, size_t len) override;
     size_t DoNext(const void** ptr, size_t len) override;
 
+    void DoBackUp(size_t count) override {
+        array_input_.BackUp(count);
+    }
+
+private:
+    void Refill();
+
 private:
     std::unique_ptr<InputStream> const source_;
     ArrayInput array_input_;
     std::vector<uint8_t> buffer_;
+    const size_t min_buflen_;
+    const size_t max_buflen_;
+    /// Size of the data got from the source by the last read into the buffer.
+    size_t last_read_ = 0;
+    /// Number of consecutive reads which would have fit into the minimal buffer.
+    size_t small_reads_ = 0;
 };
 
 }
@@ -6,6 +6,21 @@
 
 namespace clickhouse {
 
+size_t OutputStream::DoWriteV(const OutputChunk* chunks, size_t count) {
+    size_t total = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const size_t written = DoWrite(chunks[i].data, chunks[i].len);
+        total += written;
+
+        if (written < chunks[i].len) {
+            break;
+        }
+    }
+
+    return total;
+}
+
+
 size_t ZeroCopyOutput::DoWrite(const void* data, size_t len) {
     const size_t original_len = len;
     while (len > 0) {
@@ -65,6 +80,14 @@ size_t BufferOutput::DoNext(void** data, size_t len) {
     return len;
 }
 
+void BufferOutput::DoBackUp(size_t count) {
+    // Space added to the vector by the last Next() is removed.
+    if (pos_ == buf_->size()) {
+        buf_->resize(pos_ - count);
+    }
+    pos_ -= count;
+}
+
 
 BufferedOutput::BufferedOutput(std::unique_ptr<OutputStream> destination, size_t buflen)
     : destination_(std::move(destination))
@@ -80,6 +103,13 @@ void BufferedOutput::Reset() {
 }
 
 void BufferedOutput::DoFlush() {
+    Drain();
+
+    // Even if nothing is buffered, the destination may still be busy with data written through.
+    destination_->Flush();
+}
+
+void BufferedOutput::Drain() {
     if (array_output_.Data() != buffer_.data()) {
         size_t len = array_output_.Data() - buffer_.data();
         const uint8_t* buf = buffer_.data();
@@ -89,15 +119,13 @@ void BufferedOutput::DoFlush() {
             len -= written;
         }
 
-        destination_->Flush();
-
         array_output_.Reset(buffer_.data(), buffer_.size());
     }
 }
 
 size_t BufferedOutput::DoNext(void** data, size_t len) {
     if (array_output_.Avail() < len) {
-        Flush();
+        Drain();
     }
 
     return array_output_.Next(data, len);
@@ -105,15 +133,41 @@ size_t BufferedOutput::DoNext(void** data, size_t len) {
 }
 
 size_t BufferedOutput::DoWrite(const void* data, size_t len) {
-    if (array_output_.Avail() < len) {
-        Flush();
+    if (array_output_.Avail() >= len) {
+        return array_output_.Write(data, len);
+    }
 
-        if (len > buffer_.size() / 2) {
-            return destination_->Write(data, len);
-        }
+    // Data which doesn't fit is written along with the buffered one, unless it is small enough to be buffered instead.
+    if (len > buffer_.size() / 2) {
+        WriteThrough(data, len);
+        return len;
     }
 
+    Drain();
     return array_output_.Write(data, len);
 }
 
+void BufferedOutput::WriteThrough(const void* data, size_t len) {
+    const uint8_t* buffered = buffer_.data();
+    size_t buffered_len = array_output_.Data() - buffer_.data();
+    const uint8_t* direct = static_cast<const uint8_t*>(data);
+
+    while (buffered_len + len > 0) {
+        const OutputChunk chunks[2] = {{buffered, buffered_len}, {direct, len}};
+        size_t written = buffered_len
+            ? destination_->WriteV(chunks, 2)
+            : destination_->WriteV(chunks + 1, 1);
+
+        const size_t from_buffer = std::min(written, buffered_len);
+        buffered += from_buffer;
+        buffered_len -= from_buffer;
+        written -= from_buffer;
+
+        direct += written;
+        len -= written;
+    }
+
+    array_output_.Reset(buffer_.data(), buffer_.size());
+}
+
 }
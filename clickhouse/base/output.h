@@ -10,6 +10,12 @@
 
 namespace clickhouse {
 
+/// Piece of data written by a gather write.
+struct OutputChunk {
+    const void* data;
+    size_t len;
+};
+
 class OutputStream {
 public:
     virtual ~OutputStream()
@@ -23,10 +29,18 @@ public:
         return DoWrite(data, len);
     }
 
+    /// Writes some data of the chunks in their order, returns total number of bytes written.
+    inline size_t WriteV(const OutputChunk* chunks, size_t count) {
+        return DoWriteV(chunks, count);
+    }
+
 protected:
     virtual void DoFlush() { }
 
     virtual size_t DoWrite(const void* data, size_t len) = 0;
+
+    /// Writes chunks one by one, streams which can do it at once should override it.
+    virtual size_t DoWriteV(const OutputChunk* chunks, size_t count);
 };
 
 
@@ -36,11 +50,17 @@ public:
         return DoNext(data, size);
     }
 
+    /// Returns last \p count bytes of the buffer obtained by the last call of Next(), which haven't been written.
+    inline void BackUp(size_t count) {
+        DoBackUp(count);
+    }
+
 protected:
     // Obtains a buffer into which data can be written.  Any data written
     // into this buffer will eventually (maybe instantly, maybe later on)
     // be written to the output.
     virtual size_t DoNext(void** data, size_t len) = 0;
+    virtual void DoBackUp(size_t count) = 0;
 
     size_t DoWrite(const void* data, size_t len) override;
 };
@@ -84,6 +104,10 @@ public:
 protected:
     size_t DoNext(void** data, size_t len) override;
 
+    void DoBackUp(size_t count) override {
+        buf_ -= count;
+    }
+
 private:
     uint8_t* buf_;
     uint8_t* end_;
@@ -103,6 +127,7 @@ public:
 
 protected:
     size_t DoNext(void** data, size_t len) override;
+    void DoBackUp(size_t count) override;
 
 private:
     Buffer* buf_;
@@ -112,7 +137,8 @@ private:
 /** BufferedOutput writes data to internal buffer first.
  *
  *  Any data goes to underlying stream only if internal buffer is full
- *  or when client invokes Flush() on this.
+ *  or when client invokes Flush() on this, and only the latter flushes the underlying stream. Large pieces of data are not copied
+ *  into the buffer, but are written together with it by a gather write.
  *
  * Doesn't Flush() in destructor, client must ensure to do it manually at some point.
  */
@@ -128,6 +154,16 @@ protected:
     size_t DoNext(void** data, size_t len) override;
     size_t DoWrite(const void* data, size_t len) override;
 
+    void DoBackUp(size_t count) override {
+        array_output_.BackUp(count);
+    }
+
+private:
+    /// Writes buffered data to the destination, without flushing the latter.
+    void Drain();
+    /// Writes buffered data followed by \p data to the destination, without copying the latter.
+    void WriteThrough(const void* data, size_t len);
+
 private:
     std::unique_ptr<OutputStream> const destination_;
     Buffer buffer_;
@@ -2,6 +2,7 @@
 #include "singleton.h"
 #include "../client.h"
 
+#include <algorithm>
 #include <assert.h>
 #include <stdexcept>
 #include <system_error>
@@ -15,9 +16,14 @@
 #   include <netdb.h>
 #   include <netinet/tcp.h>
 #   include <signal.h>
+#   include <sys/uio.h>
 #   include <unistd.h>
 #endif
 
+#if defined(_linux_)
+#   include <linux/errqueue.h>
+#endif
+
 namespace clickhouse {
 
 #if defined(_win_)
@@ -326,6 +332,7 @@ Socket::Socket(const NetworkAddress & addr)
 
 Socket::Socket(Socket&& other) noexcept
     : handle_(other.handle_)
+    , zero_copy_threshold_(other.zero_copy_threshold_)
 {
     other.handle_ = INVALID_SOCKET;
 }
@@ -335,6 +342,7 @@ Socket& Socket::operator=(Socket&& other) noexcept {
         Close();
 
         handle_ = other.handle_;
+        zero_copy_threshold_ = other.zero_copy_threshold_;
         other.handle_ = INVALID_SOCKET;
     }
 
@@ -379,12 +387,31 @@ void Socket::SetTcpNoDelay(bool nodelay) noexcept {
 #endif
 }
 
+void Socket::SetNonBlock(bool value) {
+    clickhouse::SetNonBlock(handle_, value);
+}
+
+bool Socket::SetZeroCopySend(size_t threshold) noexcept {
+#if defined(_linux_)
+    int val = threshold > 0;
+    if (setsockopt(handle_, SOL_SOCKET, SO_ZEROCOPY, &val, sizeof(val)) == -1) {
+        zero_copy_threshold_ = 0;
+        return false;
+    }
+    zero_copy_threshold_ = threshold;
+    return true;
+#else
+    (void)threshold;
+    return false;
+#endif
+}
+
 std::unique_ptr<InputStream> Socket::makeInputStream() const {
     return std::make_unique<SocketInput>(handle_);
 }
 
 std::unique_ptr<OutputStream> Socket::makeOutputStream() const {
-    return std::make_unique<SocketOutput>(handle_);
+    return std::make_unique<SocketOutput>(handle_, zero_copy_threshold_);
 }
 
 
@@ -414,6 +441,10 @@ void NonSecureSocketFactory::setSocketOptions(Socket &socket, const ClientOption
     if (opts.tcp_nodelay) {
         socket.SetTcpNoDelay(opts.tcp_nodelay);
     }
+    // Compressed data is sent from a buffer which is reused right away.
+    if (opts.zero_copy_send_threshold && opts.compression_method == CompressionMethod::None) {
+        socket.SetZeroCopySend(std::max<size_t>(opts.zero_copy_send_threshold, 64 * 1024));
+    }
 }
 
 
@@ -443,16 +474,28 @@ bool SocketInput::Skip(size_t /*bytes*/) {
 }
 
 
-SocketOutput::SocketOutput(SOCKET s)
+SocketOutput::SocketOutput(SOCKET s, size_t zero_copy_threshold)
     : s_(s)
+    , zero_copy_threshold_(zero_copy_threshold)
 {
 }
 
 SocketOutput::~SocketOutput() = default;
 
+void SocketOutput::DoFlush() {
+    if (zero_copy_sent_ != zero_copy_completed_) {
+        WaitZeroCopyCompletions();
+    }
+}
+
 size_t SocketOutput::DoWrite(const void* data, size_t len) {
 #if defined (_linux_)
     static const int flags = MSG_NOSIGNAL;
+
+    if (zero_copy_threshold_ && len >= zero_copy_threshold_) {
+        const OutputChunk chunk{data, len};
+        return DoWriteV(&chunk, 1);
+    }
 #else
     static const int flags = 0;
 #endif
@@ -465,6 +508,122 @@ size_t SocketOutput::DoWrite(const void* data, size_t len) {
     return (size_t)ret;
 }
 
+size_t SocketOutput::DoWriteV(const OutputChunk* chunks, size_t count) {
+#if defined(_win_)
+    return OutputStream::DoWriteV(chunks, count);
+#else
+#   if defined (_linux_)
+    static const int flags = MSG_NOSIGNAL;
+#   else
+    static const int flags = 0;
+#   endif
+
+    // The rest of chunks, if any, is written by the next call.
+    iovec iov[16];
+    size_t iov_count = std::min(count, sizeof(iov) / sizeof(iov[0]));
+    size_t len = 0;
+
+    bool zero_copy = false;
+    if (zero_copy_threshold_) {
+        // Small chunks, like contents of buffers, may be modified right after return,
+        // so they are never sent together with the ones sent without copying.
+        zero_copy = chunks[0].len >= zero_copy_threshold_;
+        size_t same = 1;
+        while (same < iov_count && (chunks[same].len >= zero_copy_threshold_) == zero_copy) {
+            ++same;
+        }
+        iov_count = same;
+    }
+
+    for (size_t i = 0; i < iov_count; ++i) {
+        iov[i].iov_base = const_cast<void*>(chunks[i].data);
+        iov[i].iov_len = chunks[i].len;
+        len += chunks[i].len;
+    }
+
+    msghdr msg{};
+    msg.msg_iov = iov;
+    msg.msg_iovlen = static_cast<decltype(msg.msg_iovlen)>(iov_count);
+
+    ssize_t ret = -1;
+#   if defined (_linux_)
+    if (zero_copy) {
+        ret = ::sendmsg(s_, &msg, flags | MSG_ZEROCOPY);
+        if (ret >= 0) {
+            ++zero_copy_sent_;
+        } else if (errno == ENOBUFS) {
+            // Kernel has no memory to track one more send, copy the data this time.
+            ret = ::sendmsg(s_, &msg, flags);
+        }
+    } else
+#   endif
+    {
+        ret = ::sendmsg(s_, &msg, flags);
+    }
+
+    if (ret < 0) {
+        throw std::system_error(getSocketErrorCode(), getErrorCategory(), "fail to send " + std::to_string(len) + " bytes of data");
+    }
+
+    return (size_t)ret;
+#endif
+}
+
+void SocketOutput::WaitZeroCopyCompletions() {
+#if defined(_linux_)
+    // Notifications are waited for as long as a send may block.
+    timeval send_timeout{};
+    socklen_t optlen = sizeof(send_timeout);
+    getsockopt(s_, SOL_SOCKET, SO_SNDTIMEO, &send_timeout, &optlen);
+    const int timeout = (send_timeout.tv_sec || send_timeout.tv_usec)
+        ? static_cast<int>(send_timeout.tv_sec * 1000 + send_timeout.tv_usec / 1000)
+        : -1;
+
+    while (zero_copy_completed_ != zero_copy_sent_) {
+        char control[128];
+        msghdr msg{};
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        // Reading of the error queue never blocks.
+        if (::recvmsg(s_, &msg, MSG_ERRQUEUE) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                throw std::system_error(getSocketErrorCode(), getErrorCategory(), "fail to receive send notifications");
+            }
+
+            // The error queue isn't empty when POLLERR is set.
+            pollfd fd{s_, 0, 0};
+            const auto ret = Poll(&fd, 1, timeout);
+            if (ret == 0) {
+                throw std::system_error(EAGAIN, getErrorCategory(), "fail to receive send notifications");
+            }
+            if (ret < 0 && errno != EINTR) {
+                throw std::system_error(getSocketErrorCode(), getErrorCategory(), "fail to receive send notifications");
+            }
+            continue;
+        }
+
+        for (auto cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            const bool is_error = (cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR)
+                || (cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR);
+            if (!is_error) {
+                continue;
+            }
+
+            sock_extended_err err;
+            memcpy(&err, CMSG_DATA(cmsg), sizeof(err));
+            if (err.ee_origin == SO_EE_ORIGIN_ZEROCOPY) {
+                // Completed sends are reported by ranges of their numbers.
+                zero_copy_completed_ += err.ee_data - err.ee_info + 1;
+            }
+        }
+    }
+#endif
+}
+
 
 NetrworkInitializer::NetrworkInitializer() {
     struct NetrworkInitializerImpl {
@@ -120,6 +120,17 @@ public:
     /// @params nodelay whether to enable TCP_NODELAY
     void SetTcpNoDelay(bool nodelay) noexcept;
 
+    /// Switches socket to the non-blocking mode, streams of the socket expect blocking one.
+    void SetNonBlock(bool value);
+
+    /// Makes output streams send pieces of data not smaller than \p threshold with MSG_ZEROCOPY,
+    /// such data must not be modified until the stream is flushed. Returns false if not supported.
+    bool SetZeroCopySend(size_t threshold) noexcept;
+
+    inline SOCKET GetHandle() const noexcept {
+        return handle_;
+    }
+
     std::unique_ptr<InputStream> makeInputStream() const override;
     std::unique_ptr<OutputStream> makeOutputStream() const override;
 
@@ -129,6 +140,7 @@ protected:
     void Close();
 
     SOCKET handle_;
+    size_t zero_copy_threshold_ = 0;
 };
 
 
@@ -160,14 +172,25 @@ private:
 
 class SocketOutput : public OutputStream {
 public:
-    explicit SocketOutput(SOCKET s);
+    /// If \p zero_copy_threshold is not zero, SO_ZEROCOPY must be enabled on the socket.
+    explicit SocketOutput(SOCKET s, size_t zero_copy_threshold = 0);
     ~SocketOutput();
 
 protected:
+    /// Waits until the kernel has finished with data sent without copying.
+    void DoFlush() override;
     size_t DoWrite(const void* data, size_t len) override;
+    size_t DoWriteV(const OutputChunk* chunks, size_t count) override;
+
+private:
+    void WaitZeroCopyCompletions();
 
 private:
     SOCKET s_;
+    const size_t zero_copy_threshold_;
+    /// Number of sends with MSG_ZEROCOPY and number of them the kernel has reported to be completed.
+    uint32_t zero_copy_sent_ = 0;
+    uint32_t zero_copy_completed_ = 0;
 };
 
 static struct NetrworkInitializer {
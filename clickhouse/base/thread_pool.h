@@ -0,0 +1,47 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace clickhouse {
+
+/**
+ * Fixed set of worker threads executing queued tasks in order of submission.
+ *
+ * Destructor executes tasks queued, but not started yet, and joins the workers.
+ */
+class ThreadPool {
+public:
+    using Task = std::function<void()>;
+
+    explicit ThreadPool(size_t threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /// Number of worker threads.
+    size_t Size() const {
+        return workers_.size();
+    }
+
+    /// Queues task for execution, its completion or exception is delivered by the future.
+    std::future<void> Submit(Task task);
+
+private:
+    void WorkerLoop();
+
+private:
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<std::packaged_task<void()>> tasks_;
+    bool stopped_ = false;
+    std::vector<std::thread> workers_;
+};
+
+}
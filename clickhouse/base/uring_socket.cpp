@@ -0,0 +1,584 @@
+#include "uring_socket.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <deque>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace clickhouse {
+
+namespace {
+
+constexpr uint64_t RECEIVE_TAG = ~uint64_t(0);
+constexpr uint64_t CANCEL_TAG = ~uint64_t(0) - 1;
+constexpr uint64_t SEND_TAG = ~uint64_t(0) - 2;
+
+constexpr unsigned RING_ENTRIES = 64;
+/// Maximum number of chunks of a gather write sent at once.
+constexpr size_t MAX_SEND_CHUNKS = 16;
+
+constexpr uint16_t BUFFER_GROUP = 0;
+constexpr unsigned BUFFERS_COUNT = 16;
+constexpr size_t BUFFER_SIZE = 16 * 1024;
+
+[[noreturn]] void ThrowSystemError(int error, const char* what) {
+    throw std::system_error(error, std::system_category(), what);
+}
+
+template <typename T>
+T* Offset(void* base, uint32_t offset) {
+    return reinterpret_cast<T*>(static_cast<uint8_t*>(base) + offset);
+}
+
+}
+
+/// Submission and completion queues mapped from the kernel, with bookkeeping of the socket operations.
+class IoUring {
+public:
+    IoUring(int socket, std::chrono::milliseconds recv_timeout, std::chrono::milliseconds send_timeout);
+    ~IoUring();
+
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    /// Copies at most len bytes of received data to buf, waits for data if there is none.
+    size_t Receive(void* buf, size_t len);
+
+    /// Sends some data of the chunks, returns number of bytes sent.
+    size_t Send(const OutputChunk* chunks, size_t count);
+
+private:
+    io_uring_sqe* GetSqe();
+
+    /// Submits queued entries and waits for at least one completion, returns false on timeout.
+    bool SubmitAndWait(std::chrono::milliseconds timeout);
+
+    /// Handles all available completions.
+    void ReapCompletions();
+
+    void OnReceived(const io_uring_cqe& cqe);
+
+    void ArmReceive(void* buf, size_t len);
+
+    /// Cancels operation and waits for its completion, so its buffer may be released.
+    void CancelAndWait(uint64_t user_data, const bool& completed);
+
+    void SubmitCancel(uint64_t user_data);
+
+    void SetupBufferRing();
+
+    void Release();
+
+    void RecycleBuffer(uint16_t id);
+
+private:
+    const int socket_;
+    const std::chrono::milliseconds recv_timeout_;
+    const std::chrono::milliseconds send_timeout_;
+
+    int ring_fd_ = -1;
+    bool ext_arg_ = false;
+
+    void* sq_ring_ = MAP_FAILED;
+    size_t sq_ring_size_ = 0;
+    void* cq_ring_ = MAP_FAILED;
+    size_t cq_ring_size_ = 0;
+    io_uring_sqe* sqes_ = static_cast<io_uring_sqe*>(MAP_FAILED);
+    size_t sqes_size_ = 0;
+
+    unsigned* sq_head_ = nullptr;
+    unsigned* sq_tail_ = nullptr;
+    unsigned sq_mask_ = 0;
+    unsigned sq_entries_ = 0;
+    unsigned* cq_head_ = nullptr;
+    unsigned* cq_tail_ = nullptr;
+    unsigned cq_mask_ = 0;
+    io_uring_cqe* cqes_ = nullptr;
+
+    /// Buffers registered in the kernel for multishot receive, absent on old kernels.
+    io_uring_buf_ring* buf_ring_ = static_cast<io_uring_buf_ring*>(MAP_FAILED);
+    size_t buf_ring_size_ = 0;
+    uint16_t buf_ring_tail_ = 0;
+    std::vector<uint8_t> buffers_;
+    bool multishot_ = true;
+
+    /// Receive is submitted and is going to produce completions.
+    bool receive_armed_ = false;
+
+    struct Received {
+        uint16_t buffer_id;
+        size_t len;
+        size_t pos;
+    };
+    /// Data received into the registered buffers, in order of arrival.
+    std::deque<Received> received_;
+    /// Result of a receive into the buffer of the caller.
+    size_t received_directly_ = 0;
+    bool received_directly_done_ = false;
+    int receive_error_ = 0;
+    bool peer_closed_ = false;
+
+    /// Message of the send in flight, must stay valid until its completion.
+    msghdr send_msg_;
+    iovec send_iov_[MAX_SEND_CHUNKS];
+    int send_result_ = 0;
+    bool send_completed_ = false;
+};
+
+
+IoUring::IoUring(int socket, std::chrono::milliseconds recv_timeout, std::chrono::milliseconds send_timeout)
+    : socket_(socket)
+    , recv_timeout_(recv_timeout)
+    , send_timeout_(send_timeout)
+{
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    ring_fd_ = static_cast<int>(syscall(__NR_io_uring_setup, RING_ENTRIES, &params));
+    if (ring_fd_ < 0) {
+        ThrowSystemError(errno, "fail to setup io_uring");
+    }
+
+    try {
+        ext_arg_ = params.features & IORING_FEAT_EXT_ARG;
+        if (!ext_arg_ && (recv_timeout_.count() > 0 || send_timeout_.count() > 0)) {
+            ThrowSystemError(ENOTSUP, "io_uring of the kernel doesn't support timeouts");
+        }
+
+        sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        if (params.features & IORING_FEAT_SINGLE_MMAP) {
+            sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+        }
+
+        sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+        if (sq_ring_ == MAP_FAILED) {
+            ThrowSystemError(errno, "fail to map io_uring submission queue");
+        }
+
+        if (params.features & IORING_FEAT_SINGLE_MMAP) {
+            cq_ring_ = sq_ring_;
+        } else {
+            cq_ring_ = mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_CQ_RING);
+            if (cq_ring_ == MAP_FAILED) {
+                ThrowSystemError(errno, "fail to map io_uring completion queue");
+            }
+        }
+
+        sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+        sqes_ = static_cast<io_uring_sqe*>(mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES));
+        if (sqes_ == MAP_FAILED) {
+            ThrowSystemError(errno, "fail to map io_uring submission entries");
+        }
+
+        sq_head_ = Offset<unsigned>(sq_ring_, params.sq_off.head);
+        sq_tail_ = Offset<unsigned>(sq_ring_, params.sq_off.tail);
+        sq_mask_ = *Offset<unsigned>(sq_ring_, params.sq_off.ring_mask);
+        sq_entries_ = params.sq_entries;
+        cq_head_ = Offset<unsigned>(cq_ring_, params.cq_off.head);
+        cq_tail_ = Offset<unsigned>(cq_ring_, params.cq_off.tail);
+        cq_mask_ = *Offset<unsigned>(cq_ring_, params.cq_off.ring_mask);
+        cqes_ = Offset<io_uring_cqe>(cq_ring_, params.cq_off.cqes);
+
+        // Entries are always submitted in order of their slots.
+        auto array = Offset<unsigned>(sq_ring_, params.sq_off.array);
+        for (unsigned i = 0; i < sq_entries_; ++i) {
+            array[i] = i;
+        }
+
+        SetupBufferRing();
+    } catch (...) {
+        Release();
+        throw;
+    }
+}
+
+IoUring::~IoUring() {
+    Release();
+}
+
+void IoUring::Release() {
+    // Closing of the ring cancels all of its operations.
+    if (ring_fd_ >= 0) {
+        close(ring_fd_);
+        ring_fd_ = -1;
+    }
+    if (buf_ring_ != MAP_FAILED) {
+        munmap(buf_ring_, buf_ring_size_);
+        buf_ring_ = static_cast<io_uring_buf_ring*>(MAP_FAILED);
+    }
+    if (sqes_ != MAP_FAILED) {
+        munmap(sqes_, sqes_size_);
+        sqes_ = static_cast<io_uring_sqe*>(MAP_FAILED);
+    }
+    if (cq_ring_ != MAP_FAILED && cq_ring_ != sq_ring_) {
+        munmap(cq_ring_, cq_ring_size_);
+    }
+    cq_ring_ = MAP_FAILED;
+    if (sq_ring_ != MAP_FAILED) {
+        munmap(sq_ring_, sq_ring_size_);
+        sq_ring_ = MAP_FAILED;
+    }
+}
+
+void IoUring::SetupBufferRing() {
+    buf_ring_size_ = BUFFERS_COUNT * sizeof(io_uring_buf);
+    void* ring = mmap(nullptr, buf_ring_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ring == MAP_FAILED) {
+        ThrowSystemError(errno, "fail to allocate io_uring buffer ring");
+    }
+
+    io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = reinterpret_cast<uint64_t>(ring);
+    reg.ring_entries = BUFFERS_COUNT;
+    reg.bgid = BUFFER_GROUP;
+
+    if (syscall(__NR_io_uring_register, ring_fd_, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        // Not supported by the kernel, data is received into the buffers of the callers.
+        munmap(ring, buf_ring_size_);
+        multishot_ = false;
+        return;
+    }
+
+    buf_ring_ = static_cast<io_uring_buf_ring*>(ring);
+    buffers_.resize(BUFFERS_COUNT * BUFFER_SIZE);
+    for (unsigned i = 0; i < BUFFERS_COUNT; ++i) {
+        RecycleBuffer(static_cast<uint16_t>(i));
+    }
+}
+
+void IoUring::RecycleBuffer(uint16_t id) {
+    // Not buf_ring_->bufs, in C++ the flexible array of the kernel header may be placed after a padding.
+    auto& buf = reinterpret_cast<io_uring_buf*>(buf_ring_)[buf_ring_tail_ & (BUFFERS_COUNT - 1)];
+    buf.addr = reinterpret_cast<uint64_t>(buffers_.data() + id * BUFFER_SIZE);
+    buf.len = BUFFER_SIZE;
+    buf.bid = id;
+
+    ++buf_ring_tail_;
+    __atomic_store_n(&buf_ring_->tail, buf_ring_tail_, __ATOMIC_RELEASE);
+}
+
+io_uring_sqe* IoUring::GetSqe() {
+    const unsigned tail = *sq_tail_;
+    if (tail - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) >= sq_entries_) {
+        // Never happens since there are at most a few operations in flight.
+        ThrowSystemError(EBUSY, "io_uring submission queue is full");
+    }
+
+    auto sqe = &sqes_[tail & sq_mask_];
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+bool IoUring::SubmitAndWait(std::chrono::milliseconds timeout) {
+    const bool has_timeout = timeout.count() > 0;
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+
+    while (true) {
+        __kernel_timespec ts;
+        io_uring_getevents_arg arg;
+        memset(&arg, 0, sizeof(arg));
+
+        unsigned flags = IORING_ENTER_GETEVENTS;
+        const void* argp = nullptr;
+        size_t argsz = 0;
+        if (has_timeout) {
+            const auto left = std::max(std::chrono::nanoseconds(0), deadline - std::chrono::steady_clock::now());
+            ts.tv_sec = left.count() / 1000000000;
+            ts.tv_nsec = left.count() % 1000000000;
+            arg.sigmask_sz = _NSIG / 8;
+            arg.ts = reinterpret_cast<uint64_t>(&ts);
+            flags |= IORING_ENTER_EXT_ARG;
+            argp = &arg;
+            argsz = sizeof(arg);
+        }
+
+        const unsigned to_submit = *sq_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+        const long ret = syscall(__NR_io_uring_enter, ring_fd_, to_submit, 1, flags, argp, argsz);
+        const bool completed = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE) != *cq_head_;
+
+        if (ret >= 0) {
+            // Waiting is interrupted by the submission of entries, which takes precedence over the timeout.
+            if (completed || !has_timeout) {
+                return true;
+            }
+            if (std::chrono::steady_clock::now() >= deadline) {
+                return false;
+            }
+            continue;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno == ETIME) {
+            return completed;
+        }
+        ThrowSystemError(errno, "fail to enter io_uring");
+    }
+}
+
+void IoUring::ReapCompletions() {
+    unsigned head = *cq_head_;
+    while (head != __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE)) {
+        const io_uring_cqe cqe = cqes_[head & cq_mask_];
+        __atomic_store_n(cq_head_, ++head, __ATOMIC_RELEASE);
+
+        if (cqe.user_data == RECEIVE_TAG) {
+            OnReceived(cqe);
+        } else if (cqe.user_data == SEND_TAG) {
+            send_result_ = cqe.res;
+            send_completed_ = true;
+        }
+    }
+}
+
+void IoUring::OnReceived(const io_uring_cqe& cqe) {
+    if (!(cqe.flags & IORING_CQE_F_MORE)) {
+        receive_armed_ = false;
+    }
+
+    if (cqe.res > 0) {
+        if (buf_ring_ != MAP_FAILED) {
+            received_.push_back(Received{static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT), static_cast<size_t>(cqe.res), 0});
+        } else {
+            received_directly_ = static_cast<size_t>(cqe.res);
+            received_directly_done_ = true;
+        }
+    } else if (cqe.res == 0) {
+        peer_closed_ = true;
+        received_directly_done_ = true;
+    } else if (cqe.res == -EINVAL && multishot_) {
+        // Multishot receive is not supported by the kernel, fallback to one receive per read.
+        multishot_ = false;
+    } else if (cqe.res == -ENOBUFS) {
+        // All registered buffers hold received data, receive is rearmed once they are consumed.
+    } else if (cqe.res != -ECANCELED) {
+        receive_error_ = -cqe.res;
+        received_directly_done_ = true;
+    } else {
+        received_directly_done_ = true;
+    }
+}
+
+void IoUring::ArmReceive(void* buf, size_t len) {
+    auto sqe = GetSqe();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = socket_;
+    sqe->user_data = RECEIVE_TAG;
+
+    if (buf_ring_ != MAP_FAILED) {
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = BUFFER_GROUP;
+        sqe->ioprio = multishot_ ? IORING_RECV_MULTISHOT : 0;
+    } else {
+        sqe->addr = reinterpret_cast<uint64_t>(buf);
+        sqe->len = static_cast<uint32_t>(std::min<size_t>(len, UINT32_MAX));
+        received_directly_ = 0;
+        received_directly_done_ = false;
+    }
+
+    __atomic_store_n(sq_tail_, *sq_tail_ + 1, __ATOMIC_RELEASE);
+    receive_armed_ = true;
+}
+
+void IoUring::SubmitCancel(uint64_t user_data) {
+    auto sqe = GetSqe();
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->addr = user_data;
+    sqe->user_data = CANCEL_TAG;
+    __atomic_store_n(sq_tail_, *sq_tail_ + 1, __ATOMIC_RELEASE);
+}
+
+void IoUring::CancelAndWait(uint64_t user_data, const bool& completed) {
+    SubmitCancel(user_data);
+
+    while (!completed) {
+        SubmitAndWait(std::chrono::milliseconds(0));
+        ReapCompletions();
+    }
+}
+
+size_t IoUring::Receive(void* buf, size_t len) {
+    while (true) {
+        if (!received_.empty()) {
+            auto& chunk = received_.front();
+            const size_t n = std::min(len, chunk.len - chunk.pos);
+            memcpy(buf, buffers_.data() + chunk.buffer_id * BUFFER_SIZE + chunk.pos, n);
+            chunk.pos += n;
+
+            if (chunk.pos == chunk.len) {
+                RecycleBuffer(chunk.buffer_id);
+                received_.pop_front();
+            }
+            return n;
+        }
+
+        if (receive_error_) {
+            ThrowSystemError(std::exchange(receive_error_, 0), "can't receive string data");
+        }
+        if (peer_closed_) {
+            ThrowSystemError(ECONNRESET, "closed");
+        }
+
+        if (!receive_armed_) {
+            ArmReceive(buf, len);
+        }
+
+        if (!SubmitAndWait(recv_timeout_)) {
+            if (buf_ring_ == MAP_FAILED) {
+                // Data must not be received into the buffer after return.
+                receive_armed_ = false;
+                CancelAndWait(RECEIVE_TAG, received_directly_done_);
+                if (received_directly_) {
+                    return std::exchange(received_directly_, 0);
+                }
+            }
+            ThrowSystemError(EAGAIN, "can't receive string data");
+        }
+        ReapCompletions();
+
+        if (buf_ring_ == MAP_FAILED && received_directly_done_ && received_directly_) {
+            return std::exchange(received_directly_, 0);
+        }
+    }
+}
+
+size_t IoUring::Send(const OutputChunk* chunks, size_t count) {
+    count = std::min(count, MAX_SEND_CHUNKS);
+
+    // Chunks are sent by a single operation: a short send doesn't break a chain of linked sends,
+    // so the next chunk would go to the socket before the rest of the previous one.
+    for (size_t i = 0; i < count; ++i) {
+        send_iov_[i].iov_base = const_cast<void*>(chunks[i].data);
+        send_iov_[i].iov_len = chunks[i].len;
+    }
+    memset(&send_msg_, 0, sizeof(send_msg_));
+    send_msg_.msg_iov = send_iov_;
+    send_msg_.msg_iovlen = count;
+
+    auto sqe = GetSqe();
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = socket_;
+    sqe->addr = reinterpret_cast<uint64_t>(&send_msg_);
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = SEND_TAG;
+    __atomic_store_n(sq_tail_, *sq_tail_ + 1, __ATOMIC_RELEASE);
+
+    send_result_ = 0;
+    send_completed_ = false;
+
+    while (!send_completed_) {
+        if (!SubmitAndWait(send_timeout_)) {
+            // Data of the chunks must not be accessed after return.
+            CancelAndWait(SEND_TAG, send_completed_);
+            if (send_result_ <= 0) {
+                ThrowSystemError(EAGAIN, "fail to send data");
+            }
+            break;
+        }
+        ReapCompletions();
+    }
+
+    if (send_result_ < 0) {
+        ThrowSystemError(-send_result_, "fail to send data");
+    }
+
+    return static_cast<size_t>(send_result_);
+}
+
+
+namespace {
+
+class UringInput : public InputStream {
+public:
+    explicit UringInput(std::shared_ptr<IoUring> ring)
+        : ring_(std::move(ring))
+    {
+    }
+
+protected:
+    bool Skip(size_t) override {
+        return false;
+    }
+
+    size_t DoRead(void* buf, size_t len) override {
+        return ring_->Receive(buf, len);
+    }
+
+private:
+    std::shared_ptr<IoUring> ring_;
+};
+
+class UringOutput : public OutputStream {
+public:
+    explicit UringOutput(std::shared_ptr<IoUring> ring)
+        : ring_(std::move(ring))
+    {
+    }
+
+protected:
+    size_t DoWrite(const void* data, size_t len) override {
+        const OutputChunk chunk{data, len};
+        return ring_->Send(&chunk, 1);
+    }
+
+    size_t DoWriteV(const OutputChunk* chunks, size_t count) override {
+        return ring_->Send(chunks, count);
+    }
+
+private:
+    std::shared_ptr<IoUring> ring_;
+};
+
+}
+
+
+UringSocket::UringSocket(const NetworkAddress& addr, const SocketTimeoutParams& timeout_params)
+    : Socket(addr, timeout_params)
+{
+    try {
+        ring_ = std::make_shared<IoUring>(handle_, timeout_params.recv_timeout, timeout_params.send_timeout);
+    } catch (const std::system_error&) {
+        // io_uring is disabled or not supported, use plain system calls.
+    }
+}
+
+UringSocket::~UringSocket() = default;
+
+std::unique_ptr<InputStream> UringSocket::makeInputStream() const {
+    if (!ring_) {
+        return Socket::makeInputStream();
+    }
+    return std::make_unique<UringInput>(ring_);
+}
+
+std::unique_ptr<OutputStream> UringSocket::makeOutputStream() const {
+    if (!ring_) {
+        return Socket::makeOutputStream();
+    }
+    return std::make_unique<UringOutput>(ring_);
+}
+
+
+UringSocketFactory::~UringSocketFactory() = default;
+
+std::unique_ptr<Socket> UringSocketFactory::doConnect(const NetworkAddress& address, const ClientOptions& opts) {
+    SocketTimeoutParams timeout_params { opts.connection_connect_timeout, opts.connection_recv_timeout, opts.connection_send_timeout };
+    return std::make_unique<UringSocket>(address, timeout_params);
+}
+
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "socket.h"
+
+#include <memory>
+
+namespace clickhouse {
+
+class IoUring;
+
+/**
+ * Socket which performs IO through an io_uring instance of its own.
+ *
+ * Data is received by a multishot receive into a ring of buffers registered in the kernel,
+ * so the receive is submitted once and then only its completions are reaped. Chunks of
+ * a gather write are sent by a single sendmsg operation.
+ *
+ * On kernels without buffer rings (before 5.19) or multishot receive (before 6.0)
+ * data is received by a receive operation submitted for each read. If io_uring is not
+ * available at all, the socket is read and written by plain system calls.
+ */
+class UringSocket : public Socket {
+public:
+    UringSocket(const NetworkAddress& addr, const SocketTimeoutParams& timeout_params);
+    ~UringSocket() override;
+
+    std::unique_ptr<InputStream> makeInputStream() const override;
+    std::unique_ptr<OutputStream> makeOutputStream() const override;
+
+private:
+    std::shared_ptr<IoUring> ring_;
+};
+
+
+/// Creates connections with UringSocket, see ClientOptions::SetUseIoUring().
+class UringSocketFactory : public NonSecureSocketFactory {
+public:
+    ~UringSocketFactory() override;
+
+protected:
+    std::unique_ptr<Socket> doConnect(const NetworkAddress& address, const ClientOptions& opts) override;
+};
+
+}
@@ -0,0 +1,209 @@
+#include "varint.h"
+
+#include <cstring>
+
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#   include <immintrin.h>
+#   define HAVE_BMI2_KERNELS 1
+#endif
+
+namespace clickhouse {
+namespace {
+
+constexpr size_t MAX_VARINT_BYTES = 10;
+
+inline bool DecodeVarint(const uint8_t*& pos, const uint8_t* end, uint64_t* value) {
+    uint64_t result = 0;
+
+    for (size_t i = 0; i < MAX_VARINT_BYTES && pos + i != end; ++i) {
+        const uint8_t byte = pos[i];
+        result |= uint64_t(byte & 0x7F) << (7 * i);
+
+        if (!(byte & 0x80)) {
+            pos += i + 1;
+            *value = result;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+inline size_t VarintSize(uint64_t value) {
+    size_t size = 1;
+    while (value > 0x7F) {
+        value >>= 7;
+        ++size;
+    }
+    return size;
+}
+
+size_t DecodeStringsScalar(const uint8_t* data, size_t len, std::string_view* items, size_t count, size_t* decoded) {
+    const uint8_t* pos = data;
+    const uint8_t* const end = data + len;
+    size_t n = 0;
+
+    for (; n < count; ++n) {
+        const uint8_t* p = pos;
+        uint64_t size;
+        if (!DecodeVarint(p, end, &size) || size > size_t(end - p)) {
+            break;
+        }
+
+        items[n] = std::string_view(reinterpret_cast<const char*>(p), size);
+        pos = p + size;
+    }
+
+    *decoded = n;
+    return pos - data;
+}
+
+size_t EncodeStringsScalar(const std::string_view* items, size_t count, uint8_t* data, size_t len, size_t* encoded) {
+    uint8_t* pos = data;
+    uint8_t* const end = data + len;
+    size_t n = 0;
+
+    for (; n < count; ++n) {
+        uint64_t size = items[n].size();
+        if (VarintSize(size) + size > size_t(end - pos)) {
+            break;
+        }
+
+        while (size > 0x7F) {
+            *pos++ = static_cast<uint8_t>(size | 0x80);
+            size >>= 7;
+        }
+        *pos++ = static_cast<uint8_t>(size);
+
+        if (items[n].size()) {
+            memcpy(pos, items[n].data(), items[n].size());
+            pos += items[n].size();
+        }
+    }
+
+    *encoded = n;
+    return pos - data;
+}
+
+#if defined(HAVE_BMI2_KERNELS)
+
+constexpr uint64_t PAYLOAD_BITS = 0x7F7F7F7F7F7F7F7FULL;
+constexpr uint64_t CONTINUATION_BITS = 0x8080808080808080ULL;
+
+__attribute__((target("bmi2")))
+size_t DecodeStringsBmi2(const uint8_t* data, size_t len, std::string_view* items, size_t count, size_t* decoded) {
+    const uint8_t* pos = data;
+    const uint8_t* const end = data + len;
+    size_t n = 0;
+
+    // Lengths are read by 8 bytes, the tail of the buffer is left to the scalar loop.
+    for (; n < count && end - pos >= 8; ++n) {
+        uint64_t word;
+        memcpy(&word, pos, sizeof(word));
+
+        const uint8_t* p = pos;
+        uint64_t size;
+        if (!(word & 0x80)) {
+            size = word & 0x7F;
+            p += 1;
+        } else if (const uint64_t stops = ~word & CONTINUATION_BITS) {
+            // Bytes up to the first one without the continuation bit form the length.
+            const unsigned bits = __builtin_ctzll(stops) + 1;
+            const uint64_t mask = (bits == 64) ? ~0ULL : ((1ULL << bits) - 1);
+            size = _pext_u64(word & mask, PAYLOAD_BITS);
+            p += bits / 8;
+        } else if (!DecodeVarint(p, end, &size)) {
+            break;
+        }
+
+        if (size > size_t(end - p)) {
+            break;
+        }
+
+        items[n] = std::string_view(reinterpret_cast<const char*>(p), size);
+        pos = p + size;
+    }
+
+    size_t tail = 0;
+    pos += DecodeStringsScalar(pos, end - pos, items + n, count - n, &tail);
+
+    *decoded = n + tail;
+    return pos - data;
+}
+
+__attribute__((target("bmi2")))
+size_t EncodeStringsBmi2(const std::string_view* items, size_t count, uint8_t* data, size_t len, size_t* encoded) {
+    uint8_t* pos = data;
+    uint8_t* const end = data + len;
+    size_t n = 0;
+
+    for (; n < count; ++n) {
+        const uint64_t size = items[n].size();
+
+        if (size <= 0x7F) {
+            if (size + 1 > size_t(end - pos)) {
+                break;
+            }
+            *pos++ = static_cast<uint8_t>(size);
+        } else {
+            // Length is stored by 8 bytes, longer ones and the tail of the buffer are left to the scalar loop.
+            const size_t varint_size = (64 - __builtin_clzll(size) + 6) / 7;
+            if (varint_size > 8 || end - pos < 8 || varint_size + size > size_t(end - pos)) {
+                break;
+            }
+
+            const uint64_t word = _pdep_u64(size, PAYLOAD_BITS)
+                | (CONTINUATION_BITS & ((1ULL << (8 * (varint_size - 1))) - 1));
+            memcpy(pos, &word, sizeof(word));
+            pos += varint_size;
+        }
+
+        if (size) {
+            memcpy(pos, items[n].data(), size);
+            pos += size;
+        }
+    }
+
+    size_t tail = 0;
+    pos += EncodeStringsScalar(items + n, count - n, pos, end - pos, &tail);
+
+    *encoded = n + tail;
+    return pos - data;
+}
+
+#endif
+
+struct Kernels {
+    decltype(&DecodeStringsScalar) decode = DecodeStringsScalar;
+    decltype(&EncodeStringsScalar) encode = EncodeStringsScalar;
+};
+
+Kernels SelectKernels() {
+    Kernels kernels;
+#if defined(HAVE_BMI2_KERNELS)
+    __builtin_cpu_init();
+    // PEXT and PDEP are microcoded and slow on AMD family 17h (Zen, Zen 2).
+    if (__builtin_cpu_supports("bmi2") && !__builtin_cpu_is("amdfam17h")) {
+        kernels.decode = DecodeStringsBmi2;
+        kernels.encode = EncodeStringsBmi2;
+    }
+#endif
+    return kernels;
+}
+
+const Kernels& GetKernels() {
+    static const Kernels kernels = SelectKernels();
+    return kernels;
+}
+
+}
+
+size_t DecodeStrings(const uint8_t* data, size_t len, std::string_view* items, size_t count, size_t* decoded) {
+    return GetKernels().decode(data, len, items, count, decoded);
+}
+
+size_t EncodeStrings(const std::string_view* items, size_t count, uint8_t* data, size_t len, size_t* encoded) {
+    return GetKernels().encode(items, count, data, len, encoded);
+}
+
+}
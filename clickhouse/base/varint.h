@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace clickhouse {
+
+/**
+ * Kernels for runs of strings in the native format, i.e. varint length followed by bytes.
+ *
+ * Implementation is selected once by the features of the CPU: x86-64 CPUs with fast BMI2
+ * decode and encode a multibyte length by a single load or store, others use the scalar loop.
+ */
+
+/// Decodes at most \p count strings lying entirely in [data, data + len) into \p items,
+/// stores their number into \p decoded and returns the number of bytes they take.
+size_t DecodeStrings(const uint8_t* data, size_t len, std::string_view* items, size_t count, size_t* decoded);
+
+/// Encodes at most \p count strings of \p items, which fit entirely into [data, data + len),
+/// stores their number into \p encoded and returns the number of bytes they take.
+size_t EncodeStrings(const std::string_view* items, size_t count, uint8_t* data, size_t len, size_t* encoded);
+
+}
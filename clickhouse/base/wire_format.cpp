@@ -168,6 +168,120 @@ void WireFormat::WriteQuotedString(OutputStream& output, std::string_view value)
     WriteAll(output, "'", 1);
 }
 
+bool WireReader::ReadString(std::string* value) {
+    uint64_t len = 0;
+    if (ReadVarint64(&len)) {
+        if (len > 0x00FFFFFFULL) {
+            return false;
+        }
+        value->resize((size_t)len);
+        return ReadBytes(value->data(), (size_t)len);
+    }
+
+    return false;
+}
+
+const std::shared_ptr<const void>& WireReader::GetBufferOwner() {
+    if (!owner_known_) {
+        owner_ = input_.GetBufferOwner();
+        owner_known_ = true;
+    }
+    return owner_;
+}
+
+void WireReader::Release() noexcept {
+    if (pos_ != end_) {
+        input_.BackUp(Avail());
+    }
+    pos_ = end_ = nullptr;
+}
+
+bool WireReader::Refill() {
+    const void* ptr = nullptr;
+    const size_t len = input_.Next(&ptr, SIZE_MAX);
+
+    pos_ = static_cast<const uint8_t*>(ptr);
+    end_ = pos_ + len;
+    owner_.reset();
+    owner_known_ = false;
+
+    return len > 0;
+}
+
+bool WireReader::ReadBytesSlow(void* buf, size_t len) {
+    const size_t head = Avail();
+    if (head) {
+        std::memcpy(buf, pos_, head);
+    }
+    pos_ = end_ = nullptr;
+
+    // Reading through the stream lets it place large data right into the destination.
+    return WireFormat::ReadBytes(input_, static_cast<uint8_t*>(buf) + head, len - head);
+}
+
+bool WireReader::ReadVarint64Slow(uint64_t* value) {
+    *value = 0;
+
+    for (size_t i = 0; i < MAX_VARINT_BYTES; ++i) {
+        if (pos_ == end_ && !Refill()) {
+            return false;
+        }
+
+        const uint8_t byte = *pos_++;
+        *value |= uint64_t(byte & 0x7F) << (7 * i);
+
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void WireWriter::Release() noexcept {
+    if (pos_ != end_) {
+        output_.BackUp(Avail());
+    }
+    pos_ = end_ = nullptr;
+}
+
+bool WireWriter::Reserve(size_t len) {
+    Release();
+
+    void* ptr = nullptr;
+    const size_t reserved = output_.Next(&ptr, std::max(len, RESERVE_SIZE));
+
+    pos_ = static_cast<uint8_t*>(ptr);
+    end_ = pos_ + reserved;
+
+    return reserved >= len;
+}
+
+void WireWriter::WriteBytesSlow(const void* buf, size_t len) {
+    const size_t head = Avail();
+    if (head) {
+        std::memcpy(pos_, buf, head);
+        pos_ += head;
+    }
+    buf = static_cast<const uint8_t*>(buf) + head;
+    len -= head;
+
+    if (len < RESERVE_SIZE && Reserve(len)) {
+        std::memcpy(pos_, buf, len);
+        pos_ += len;
+        return;
+    }
+
+    // Large data is written through the stream, which may pass it on without copying.
+    Release();
+    WireFormat::WriteBytes(output_, buf, len);
+}
+
+void WireWriter::WriteVarint64Slow(uint64_t value) {
+    Release();
+    WireFormat::WriteVarint64(output_, value);
+}
+
 void WireFormat::WriteParamNullRepresentation(OutputStream& output) {
     const std::string NULL_REPRESENTATION(R"('\\N')");
     WriteVarint64(output, NULL_REPRESENTATION.size());
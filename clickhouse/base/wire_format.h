@@ -1,12 +1,17 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <cstdint>
+#include <cstring>
+#include <memory>
 
 namespace clickhouse {
 
 class InputStream;
 class OutputStream;
+class ZeroCopyInput;
+class ZeroCopyOutput;
 
 class WireFormat {
 public:
@@ -32,6 +37,210 @@ private:
     static void WriteAll(OutputStream& output, const void* buf, size_t len);
 };
 
+/**
+ * Reads the wire format right from the buffer of a ZeroCopyInput.
+ *
+ * Values which lie in the current buffer are decoded inline, only values crossing
+ * the end of the buffer take the slow path through the stream.
+ * Data of the buffer not read yet is returned to the stream by Release() or the destructor,
+ * the stream must not be read by other means in the meantime.
+ */
+class WireReader {
+public:
+    explicit WireReader(ZeroCopyInput& input) noexcept
+        : input_(input)
+    { }
+
+    ~WireReader() {
+        Release();
+    }
+
+    WireReader(const WireReader&) = delete;
+    WireReader& operator=(const WireReader&) = delete;
+
+    template <typename T>
+    inline bool ReadFixed(T* value) {
+        return ReadBytes(value, sizeof(T));
+    }
+
+    inline bool ReadBytes(void* buf, size_t len) {
+        if (len <= Avail()) {
+            std::memcpy(buf, pos_, len);
+            pos_ += len;
+            return true;
+        }
+        return ReadBytesSlow(buf, len);
+    }
+
+    inline bool ReadVarint64(uint64_t* value) {
+        if (Avail() < MAX_VARINT_BYTES) {
+            return ReadVarint64Slow(value);
+        }
+
+        uint64_t result = 0;
+        for (size_t i = 0; i < MAX_VARINT_BYTES; ++i) {
+            const uint8_t byte = pos_[i];
+            result |= uint64_t(byte & 0x7F) << (7 * i);
+
+            if (!(byte & 0x80)) {
+                pos_ += i + 1;
+                *value = result;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    inline bool ReadUInt64(uint64_t* value) {
+        return ReadVarint64(value);
+    }
+
+    bool ReadString(std::string* value);
+
+    /// Returns pointer to the next \p len bytes if the buffer holds them, or null.
+    inline const void* ReadInPlace(size_t len) {
+        if (len > Avail() && (pos_ != end_ || !Refill() || len > Avail())) {
+            return nullptr;
+        }
+
+        const void* result = pos_;
+        pos_ += len;
+        return result;
+    }
+
+    /// Returns the rest of the current buffer, the next one is taken if it's empty.
+    inline size_t Peek(const void** data) {
+        if (pos_ == end_) {
+            Refill();
+        }
+        *data = pos_;
+        return Avail();
+    }
+
+    /// Skips \p len bytes of the current buffer.
+    inline void Advance(size_t len) noexcept {
+        pos_ += len;
+    }
+
+    /// Owner of the current buffer, see ZeroCopyInput::GetBufferOwner().
+    const std::shared_ptr<const void>& GetBufferOwner();
+
+    /// Returns data of the current buffer not read yet to the stream.
+    void Release() noexcept;
+
+private:
+    static constexpr size_t MAX_VARINT_BYTES = 10;
+
+    inline size_t Avail() const noexcept {
+        return end_ - pos_;
+    }
+
+    bool Refill();
+    bool ReadBytesSlow(void* buf, size_t len);
+    bool ReadVarint64Slow(uint64_t* value);
+
+private:
+    ZeroCopyInput& input_;
+    const uint8_t* pos_ = nullptr;
+    const uint8_t* end_ = nullptr;
+    std::shared_ptr<const void> owner_;
+    bool owner_known_ = false;
+};
+
+/**
+ * Writes the wire format right into the buffer of a ZeroCopyOutput.
+ *
+ * Space is reserved by pieces of several values, which are encoded inline, only values
+ * which don't fit into the rest of the piece take the slow path.
+ * Reserved space not written yet is returned to the stream by Release() or the destructor,
+ * the stream must not be written by other means in the meantime.
+ */
+class WireWriter {
+public:
+    explicit WireWriter(ZeroCopyOutput& output) noexcept
+        : output_(output)
+    { }
+
+    ~WireWriter() {
+        Release();
+    }
+
+    WireWriter(const WireWriter&) = delete;
+    WireWriter& operator=(const WireWriter&) = delete;
+
+    template <typename T>
+    inline void WriteFixed(const T& value) {
+        WriteBytes(&value, sizeof(T));
+    }
+
+    inline void WriteBytes(const void* buf, size_t len) {
+        if (len <= Avail()) {
+            std::memcpy(pos_, buf, len);
+            pos_ += len;
+            return;
+        }
+        WriteBytesSlow(buf, len);
+    }
+
+    inline void WriteVarint64(uint64_t value) {
+        if (Avail() < MAX_VARINT_BYTES && !Reserve(MAX_VARINT_BYTES)) {
+            WriteVarint64Slow(value);
+            return;
+        }
+
+        while (value > 0x7F) {
+            *pos_++ = static_cast<uint8_t>(value | 0x80);
+            value >>= 7;
+        }
+        *pos_++ = static_cast<uint8_t>(value);
+    }
+
+    inline void WriteUInt64(uint64_t value) {
+        WriteVarint64(value);
+    }
+
+    inline void WriteString(std::string_view value) {
+        WriteVarint64(value.size());
+        WriteBytes(value.data(), value.size());
+    }
+
+    /// Returns the rest of the reserved space, new space is reserved if it's empty.
+    inline size_t Peek(void** data) {
+        if (pos_ == end_) {
+            Reserve(1);
+        }
+        *data = pos_;
+        return Avail();
+    }
+
+    /// Marks \p len bytes of the reserved space as written.
+    inline void Advance(size_t len) noexcept {
+        pos_ += len;
+    }
+
+    /// Returns reserved space not written yet to the stream.
+    void Release() noexcept;
+
+private:
+    static constexpr size_t MAX_VARINT_BYTES = 10;
+    /// Space reserved at once, if the stream has it.
+    static constexpr size_t RESERVE_SIZE = 1024;
+
+    inline size_t Avail() const noexcept {
+        return end_ - pos_;
+    }
+
+    /// Reserves space for at least \p len bytes, returns false if the stream has less.
+    bool Reserve(size_t len);
+    void WriteBytesSlow(const void* buf, size_t len);
+    void WriteVarint64Slow(uint64_t value);
+
+private:
+    ZeroCopyOutput& output_;
+    uint8_t* pos_ = nullptr;
+    uint8_t* end_ = nullptr;
+};
+
 template <typename T>
 inline bool WireFormat::ReadFixed(InputStream& input, T* value) {
     return ReadAll(input, value, sizeof(T));
@@ -1,4 +1,5 @@
 #include "client.h"
+#include "client_impl.h"
 #include "clickhouse/version.h"
 #include "protocol.h"
 
@@ -9,7 +10,13 @@
 #include "columns/factory.h"
 
 #include <assert.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
 #include <system_error>
+#include <thread>
 #include <vector>
 #include <sstream>
 
@@ -17,6 +24,10 @@
 #include "base/sslsocket.h"
 #endif
 
+#if defined(WITH_IO_URING)
+#include "base/uring_socket.h"
+#endif
+
 #define DBMS_NAME                                       "ClickHouse"
 
 #define DBMS_MIN_REVISION_WITH_TEMPORARY_TABLES         50264
@@ -91,9 +102,12 @@ std::ostream& operator<<(std::ostream& os, const ClientOptions& opt) {
        << " send_retries:" << opt.send_retries
        << " retry_timeout:" << opt.retry_timeout.count()
        << " compression_method:"
-       << (opt.compression_method == CompressionMethod::LZ4    ? "LZ4"
-           : opt.compression_method == CompressionMethod::ZSTD ? "ZSTD"
-                                                               : "None");
+       << (opt.compression_method == CompressionMethod::LZ4      ? "LZ4"
+           : opt.compression_method == CompressionMethod::LZ4HC    ? "LZ4HC"
+           : opt.compression_method == CompressionMethod::ZSTD     ? "ZSTD"
+           : opt.compression_method == CompressionMethod::Adaptive ? "Adaptive"
+                                                                   : "None")
+       << " compression_level:" << opt.compression_level;
 #if defined(WITH_OPENSSL)
     if (opt.ssl_options) {
         const auto & ssl_options = *opt.ssl_options;
@@ -123,6 +137,17 @@ ClientOptions& ClientOptions::SetSSLOptions(ClientOptions::SSLOptions options)
 #endif
 }
 
+ClientOptions& ClientOptions::SetUseIoUring(bool value)
+{
+#ifdef WITH_IO_URING
+    use_io_uring = value;
+    return *this;
+#else
+    (void)value;
+    throw UnimplementedError("Library was built with no io_uring support");
+#endif
+}
+
 namespace {
 
 std::unique_ptr<SocketFactory> GetSocketFactory(const ClientOptions& opts) {
@@ -131,6 +156,11 @@ std::unique_ptr<SocketFactory> GetSocketFactory(const ClientOptions& opts) {
     if (opts.ssl_options)
         return std::make_unique<SSLSocketFactory>(opts);
     else
+#endif
+#if defined(WITH_IO_URING)
+    if (opts.use_io_uring)
+        return std::make_unique<UringSocketFactory>();
+    else
 #endif
         return std::make_unique<NonSecureSocketFactory>();
 }
@@ -144,119 +174,246 @@ std::unique_ptr<EndpointsIteratorBase> GetEndpointsIterator(const ClientOptions&
     return std::make_unique<RoundRobinEndpointsIterator>(opts.endpoints);
 }
 
+std::unique_ptr<Exception> CopyException(const Exception& e) {
+    auto copy = std::make_unique<Exception>();
+    copy->code = e.code;
+    copy->name = e.name;
+    copy->display_text = e.display_text;
+    copy->stack_trace = e.stack_trace;
+    if (e.nested) {
+        copy->nested = CopyException(*e.nested);
+    }
+    return copy;
 }
 
-class Client::Impl {
-public:
-     Impl(const ClientOptions& opts);
-     Impl(const ClientOptions& opts,
-          std::unique_ptr<SocketFactory> socket_factory);
-    ~Impl();
-
-    void ExecuteQuery(Query query);
-
-    void SendCancel();
+}
 
-    void Insert(const std::string& table_name, const std::string& query_id, const Block& block);
+ClientOptions modifyClientOptions(ClientOptions opts)
+{
+    if (opts.read_buffer_size == 0 || opts.write_buffer_size == 0)
+        throw ValidationError("Sizes of the read and write buffers must not be zero");
 
-    void Ping();
+    if (opts.host.empty())
+        return opts;
 
-    void ResetConnection();
+    Endpoint default_endpoint({opts.host, opts.port});
+    opts.endpoints.emplace(opts.endpoints.begin(), default_endpoint);
+    return opts;
+}
 
-    void ResetConnectionEndpoint();
+/**
+ * Receives and decodes packets of a query on a separate thread, at most max_blocks_ahead
+ * data blocks ahead of the consumer. Events of the query are queued and dispatched
+ * on the consumer thread in order of their arrival.
+ */
+class ReceivePipeline : public QueryEvents {
+public:
+    ReceivePipeline(Client::Impl* client, const Query& query, size_t max_blocks_ahead);
+    ~ReceivePipeline() override;
 
-    const ServerInfo& GetServerInfo() const;
+    /** Dispatches queued events to \p handler until a data block is received, which is returned via \p block.
+     *  Returns false once query is finished, throws an exception if query has failed.
+     */
+    bool Next(QueryEvents& handler, Block* block);
 
-    const std::optional<Endpoint>& GetCurrentEndpoint() const;
+    /// Discards queued events and makes the reader request the server to stop sending data.
+    void Cancel();
 
 private:
-    bool Handshake();
-
-    bool ReceivePacket(uint64_t* server_packet = nullptr);
+    // Called on the reader thread.
+    void OnData(const Block&) override { }
+    bool OnDataCancelable(const Block& block) override;
+    void OnServerException(const Exception& e) override;
+    void OnProfile(const Profile& profile) override;
+    void OnProgress(const Progress& progress) override;
+    void OnServerLog(const Block& block) override;
+    void OnProfileEvents(const Block& block) override;
+    void OnFinish() override;
+
+    void Push(std::function<void(QueryEvents&)> dispatch);
 
-    void SendQuery(const Query& query);
-
-    void SendData(const Block& block);
+private:
+    struct Event {
+        /// Either a data block or any other event.
+        std::optional<Block> data;
+        std::function<void(QueryEvents&)> dispatch;
+    };
 
-    bool SendHello();
+    Client::Impl* const client_;
+    const Query query_;
+    const size_t max_blocks_ahead_;
 
-    bool ReadBlock(InputStream& input, Block* block);
+    std::mutex mutex_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+    std::deque<Event> events_;
+    size_t data_blocks_ = 0;
+    bool finished_ = false;
+    bool cancelled_ = false;
+    std::exception_ptr error_;
 
-    bool ReceiveHello();
+    std::thread reader_;
+};
 
-    /// Reads data packet form input stream.
-    bool ReceiveData();
+ReceivePipeline::ReceivePipeline(Client::Impl* client, const Query& query, size_t max_blocks_ahead)
+    : client_(client)
+    , query_(query)
+    , max_blocks_ahead_(max_blocks_ahead)
+{
+    if (max_blocks_ahead_ == 0) {
+        throw ValidationError("query must be allowed to receive at least one block ahead");
+    }
 
-    /// Reads exception packet form input stream.
-    bool ReceiveException(bool rethrow = false);
+    client_->EnsureIdle();
 
-    void WriteBlock(const Block& block, OutputStream& output);
+    // Connection may be reset only until it is handed over to the reader.
+    if (client_->options_.ping_before_query) {
+        client_->RetryGuard([this]() { client_->DoPing(); });
+    }
 
-    void CreateConnection();
+    client_->receiving_in_background_ = true;
 
-    void InitializeStreams(std::unique_ptr<SocketBase>&& socket);
+    try {
+        reader_ = std::thread([this] () {
+            std::exception_ptr error;
+            try {
+                client_->DoExecuteQuery(query_, this);
+            } catch (...) {
+                error = std::current_exception();
+            }
 
-    inline size_t GetConnectionAttempts() const
-    {
-        return options_.endpoints.size() * options_.send_retries;
+            std::lock_guard<std::mutex> lock(mutex_);
+            finished_ = true;
+            error_ = error;
+            not_empty_.notify_all();
+        });
+    } catch (...) {
+        client_->receiving_in_background_ = false;
+        throw;
     }
+}
 
-private:
-    /// In case of network errors tries to reconnect to server and
-    /// call fuc several times.
-    void RetryGuard(std::function<void()> func);
+ReceivePipeline::~ReceivePipeline() {
+    Cancel();
+    reader_.join();
+    client_->receiving_in_background_ = false;
+}
 
-    void RetryConnectToTheEndpoint(std::function<void()>& func);
+bool ReceivePipeline::Next(QueryEvents& handler, Block* block) {
+    std::unique_lock<std::mutex> lock(mutex_);
 
-private:
-    class EnsureNull {
-    public:
-        inline EnsureNull(QueryEvents* ev, QueryEvents** ptr)
-            : ptr_(ptr)
-        {
-            if (ptr_) {
-                *ptr_ = ev;
+    for (;;) {
+        not_empty_.wait(lock, [this] { return !events_.empty() || finished_; });
+
+        if (events_.empty()) {
+            if (error_) {
+                std::rethrow_exception(error_);
             }
+            return false;
         }
 
-        inline ~EnsureNull() {
-            if (ptr_) {
-                *ptr_ = nullptr;
-            }
+        Event event = std::move(events_.front());
+        events_.pop_front();
+
+        if (event.data) {
+            --data_blocks_;
+            not_full_.notify_one();
+            *block = std::move(*event.data);
+            return true;
         }
 
-    private:
-        QueryEvents** ptr_;
+        // Handler may take a while, let the reader go on meanwhile.
+        lock.unlock();
+        event.dispatch(handler);
+        lock.lock();
+    }
+}
 
-    };
+void ReceivePipeline::Cancel() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    events_.clear();
+    data_blocks_ = 0;
+    if (!finished_) {
+        cancelled_ = true;
+        not_full_.notify_all();
+    }
+}
 
+bool ReceivePipeline::OnDataCancelable(const Block& block) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_full_.wait(lock, [this] { return data_blocks_ < max_blocks_ahead_ || cancelled_; });
 
-    const ClientOptions options_;
-    QueryEvents* events_;
-    int compression_ = CompressionState::Disable;
+    if (cancelled_) {
+        return false;
+    }
 
-    std::unique_ptr<SocketFactory> socket_factory_;
+    events_.push_back(Event{block, {}});
+    ++data_blocks_;
+    not_empty_.notify_one();
+    return true;
+}
 
-    std::unique_ptr<InputStream> input_;
-    std::unique_ptr<OutputStream> output_;
-    std::unique_ptr<SocketBase> socket_;
-    std::unique_ptr<EndpointsIteratorBase> endpoints_iterator;
+void ReceivePipeline::OnServerException(const Exception& e) {
+    std::shared_ptr<Exception> exception = CopyException(e);
+    Push([exception] (QueryEvents& handler) { handler.OnServerException(*exception); });
+}
 
-    std::optional<Endpoint> current_endpoint_;
+void ReceivePipeline::OnProfile(const Profile& profile) {
+    Push([profile] (QueryEvents& handler) { handler.OnProfile(profile); });
+}
 
-    ServerInfo server_info_;
-};
+void ReceivePipeline::OnProgress(const Progress& progress) {
+    Push([progress] (QueryEvents& handler) { handler.OnProgress(progress); });
+}
 
-ClientOptions modifyClientOptions(ClientOptions opts)
-{
-    if (opts.host.empty())
-        return opts;
+void ReceivePipeline::OnServerLog(const Block& block) {
+    Push([block] (QueryEvents& handler) { handler.OnServerLog(block); });
+}
 
-    Endpoint default_endpoint({opts.host, opts.port});
-    opts.endpoints.emplace(opts.endpoints.begin(), default_endpoint);
-    return opts;
+void ReceivePipeline::OnProfileEvents(const Block& block) {
+    Push([block] (QueryEvents& handler) { handler.OnProfileEvents(block); });
+}
+
+void ReceivePipeline::OnFinish() {
+    Push([] (QueryEvents& handler) { handler.OnFinish(); });
 }
 
+void ReceivePipeline::Push(std::function<void(QueryEvents&)> dispatch) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!cancelled_) {
+        events_.push_back(Event{std::nullopt, std::move(dispatch)});
+        not_empty_.notify_one();
+    }
+}
+
+
+class ResultCursor::Impl {
+public:
+    Impl(Client::Impl* client, const Query& query, size_t max_blocks_ahead)
+        : query_(query)
+        , pipeline_(client, query_, max_blocks_ahead)
+    {
+    }
+
+    bool Next(Block& block) {
+        // Events other than data are passed to handlers of the query.
+        while (pipeline_.Next(query_, &block)) {
+            if (block.GetRowCount() > 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void Cancel() {
+        pipeline_.Cancel();
+    }
+
+private:
+    Query query_;
+    ReceivePipeline pipeline_;
+};
+
 Client::Impl::Impl(const ClientOptions& opts)
     : Impl(opts, GetSocketFactory(opts)) {}
 
@@ -271,6 +428,10 @@ Client::Impl::Impl(const ClientOptions& opts,
 
     if (options_.compression_method != CompressionMethod::None) {
         compression_ = CompressionState::Enable;
+
+        if (options_.compression_threads > 1) {
+            compression_pool_ = std::make_unique<ThreadPool>(options_.compression_threads - 1);
+        }
     }
 }
 
@@ -278,17 +439,50 @@ Client::Impl::~Impl()
 { }
 
 void Client::Impl::ExecuteQuery(Query query) {
-    EnsureNull en(static_cast<QueryEvents*>(&query), &events_);
+    EnsureIdle();
 
-    if (options_.ping_before_query) {
-        RetryGuard([this]() { Ping(); });
+    if (options_.receive_ahead_blocks == 0) {
+        if (options_.ping_before_query) {
+            RetryGuard([this]() { DoPing(); });
+        }
+
+        DoExecuteQuery(query, &query);
+        return;
     }
 
-    SendQuery(query);
+    QueryEvents& handler = query;
+    ReceivePipeline pipeline(this, query, options_.receive_ahead_blocks);
 
-    while (ReceivePacket()) {
-        ;
+    Block block;
+    while (pipeline.Next(handler, &block)) {
+        handler.OnData(block);
+        if (!handler.OnDataCancelable(block)) {
+            pipeline.Cancel();
+        }
+    }
+}
+
+void Client::Impl::DoExecuteQuery(const Query& query, QueryEvents* events) {
+    EnsureNull en(events, &events_);
+
+    const auto* projection = query.GetColumnProjection().empty() ? nullptr : &query.GetColumnProjection();
+    EnsureNull ep(projection, &column_projection_);
+
+    try {
+        SendQuery(query);
+
+        while (ReceivePacket()) {
+            ;
+        }
+    } catch (...) {
+        recycled_columns_.clear();
+        skipped_columns_.clear();
+        throw;
     }
+
+    // Memory of the result must not outlive the query.
+    recycled_columns_.clear();
+    skipped_columns_.clear();
 }
 
 std::string NameToQueryString(const std::string &input)
@@ -310,13 +504,9 @@ std::string NameToQueryString(const std::string &input)
     return output;
 }
 
-void Client::Impl::Insert(const std::string& table_name, const std::string& query_id, const Block& block) {
-    if (options_.ping_before_query) {
-        RetryGuard([this]() { Ping(); });
-    }
-
+std::string MakeInsertQuery(const std::string& table_name, const Block& block) {
     std::stringstream fields_section;
-        const auto num_columns = block.GetColumnCount();
+    const auto num_columns = block.GetColumnCount();
 
     for (unsigned int i = 0; i < num_columns; ++i) {
         if (i == num_columns - 1) {
@@ -326,27 +516,72 @@ void Client::Impl::Insert(const std::string& table_name, const std::string& quer
         }
     }
 
-    Query query("INSERT INTO " + table_name + " ( " + fields_section.str() + " ) VALUES", query_id);
-    SendQuery(query);
+    return "INSERT INTO " + table_name + " ( " + fields_section.str() + " ) VALUES";
+}
 
-    uint64_t server_packet;
-    // Receive data packet.
-    while (true) {
-        bool ret = ReceivePacket(&server_packet);
+void Client::Impl::Insert(const std::string& table_name, const std::string& query_id, const Block& block) {
+    BeginInsert(Query(MakeInsertQuery(table_name, block), query_id));
+    SendInsertBlock(block);
+    EndInsert();
+}
 
-        if (!ret) {
-            throw ProtocolError("fail to receive data packet");
-        }
-        if (server_packet == ServerCodes::Data) {
-            break;
-        }
-        if (server_packet == ServerCodes::Progress) {
-            continue;
+Block Client::Impl::BeginInsert(Query query) {
+    EnsureIdle();
+
+    if (options_.ping_before_query) {
+        RetryGuard([this]() { Ping(); });
+    }
+
+    // Query is kept alive (along with its event handlers) for the whole duration of the INSERT.
+    insert_query_ = std::make_unique<Query>(std::move(query));
+
+    // Server responds with an empty block that describes the columns of the table,
+    // it isn't passed to the handlers of the query as data.
+    Block header;
+    try {
+        SendQuery(*insert_query_);
+
+        uint64_t server_packet;
+        while (true) {
+            bool ret = ReceivePacket(&server_packet, &header);
+
+            if (!ret) {
+                throw ProtocolError("fail to receive data packet");
+            }
+            if (server_packet == ServerCodes::Data) {
+                break;
+            }
+            if (server_packet == ServerCodes::Progress) {
+                continue;
+            }
         }
+    } catch (...) {
+        insert_query_.reset();
+        throw;
+    }
+
+    events_ = insert_query_.get();
+
+    return header;
+}
+
+void Client::Impl::SendInsertBlock(const Block& block) {
+    if (!insert_query_) {
+        throw ValidationError("INSERT is not started, call BeginInsert() first");
     }
 
-    // Send data.
     SendData(block);
+}
+
+void Client::Impl::EndInsert() {
+    if (!insert_query_) {
+        throw ValidationError("INSERT is not started, call BeginInsert() first");
+    }
+
+    // Make sure that query is released even if waiting for the end of the query fails.
+    std::unique_ptr<Query> query = std::move(insert_query_);
+    EnsureNull en(static_cast<QueryEvents*>(query.get()), &events_);
+
     // Send empty block as marker of
     // end of data.
     SendData(Block());
@@ -365,6 +600,11 @@ void Client::Impl::Insert(const std::string& table_name, const std::string& quer
 }
 
 void Client::Impl::Ping() {
+    EnsureIdle();
+    DoPing();
+}
+
+void Client::Impl::DoPing() {
     WireFormat::WriteUInt64(*output_, ClientCodes::Ping);
     output_->Flush();
 
@@ -377,6 +617,14 @@ void Client::Impl::Ping() {
 }
 
 void Client::Impl::ResetConnection() {
+    if (receiving_in_background_) {
+        throw ValidationError("cannot reset connection while result of a query is being received");
+    }
+
+    // Any INSERT in progress is abandoned along with the old connection.
+    insert_query_.reset();
+    events_ = nullptr;
+
     InitializeStreams(socket_factory_->connect(options_, current_endpoint_.value()));
 
     if (!Handshake()) {
@@ -431,6 +679,22 @@ const std::optional<Endpoint>& Client::Impl::GetCurrentEndpoint() const {
     return current_endpoint_;
 }
 
+SocketBase* Client::Impl::GetSocket() const {
+    return socket_.get();
+}
+
+void Client::Impl::ShrinkReadBuffer() {
+    // Streams replaced by AsyncClient manage their memory themselves.
+    if (auto buffered = dynamic_cast<BufferedInput*>(input_.get())) {
+        buffered->ShrinkIfIdle();
+    }
+}
+
+void Client::Impl::ReplaceStreams(std::unique_ptr<InputStream> input, std::unique_ptr<OutputStream> output) {
+    input_ = std::move(input);
+    output_ = std::move(output);
+}
+
 bool Client::Impl::Handshake() {
     if (!SendHello()) {
         return false;
@@ -446,7 +710,7 @@ bool Client::Impl::Handshake() {
     return true;
 }
 
-bool Client::Impl::ReceivePacket(uint64_t* server_packet) {
+bool Client::Impl::ReceivePacket(uint64_t* server_packet, Block* received_data) {
     uint64_t packet_type = 0;
 
     if (!WireFormat::ReadVarint64(*input_, &packet_type)) {
@@ -458,7 +722,7 @@ bool Client::Impl::ReceivePacket(uint64_t* server_packet) {
 
     switch (packet_type) {
     case ServerCodes::Data: {
-        if (!ReceiveData()) {
+        if (!ReceiveData(received_data)) {
             throw ProtocolError("can't read data packet from input stream");
         }
         return true;
@@ -538,6 +802,7 @@ bool Client::Impl::ReceivePacket(uint64_t* server_packet) {
     }
 
     case ServerCodes::EndOfStream: {
+        ShrinkReadBuffer();
         if (events_) {
             events_->OnFinish();
         }
@@ -552,7 +817,7 @@ bool Client::Impl::ReceivePacket(uint64_t* server_packet) {
         Block block;
 
         // Use uncompressed stream since log blocks usually contain only one row
-        if (!ReadBlock(*input_, &block)) {
+        if (!ReadBlock(*input_, &block, packet_type)) {
             return false;
         }
 
@@ -581,7 +846,7 @@ bool Client::Impl::ReceivePacket(uint64_t* server_packet) {
         }
 
         Block block;
-        if (!ReadBlock(*input_, &block)) {
+        if (!ReadBlock(*input_, &block, packet_type)) {
             return false;
         }
 
@@ -597,7 +862,32 @@ bool Client::Impl::ReceivePacket(uint64_t* server_packet) {
     }
 }
 
-bool Client::Impl::ReadBlock(InputStream& input, Block* block) {
+ColumnRef Client::Impl::CreateColumn(uint64_t packet_type, size_t position, const std::string& type, const CreateColumnByTypeSettings& settings) {
+    if (!options_.recycle_blocks) {
+        return CreateColumnByType(type, settings);
+    }
+
+    // Blocks of logs and profile events have other columns than the data blocks in between them.
+    auto& recycled_columns = recycled_columns_[packet_type];
+    if (recycled_columns.size() <= position) {
+        recycled_columns.resize(position + 1);
+    }
+
+    auto& [recycled_type, recycled] = recycled_columns[position];
+    // Column is reused only if it isn't referenced by a block passed to the user anymore.
+    if (recycled && recycled.use_count() == 1 && recycled_type == type) {
+        // Pairs with release of the last outer reference, which may happen on another thread.
+        std::atomic_thread_fence(std::memory_order_acquire);
+        recycled->Clear();
+        return recycled;
+    }
+
+    recycled_type = type;
+    recycled = CreateColumnByType(type, settings);
+    return recycled;
+}
+
+bool Client::Impl::ReadBlock(InputStream& input, Block* block, uint64_t packet_type) {
     // Additional information about block.
     if (server_info_.revision >= DBMS_MIN_REVISION_WITH_BLOCK_INFO) {
         uint64_t num;
@@ -635,6 +925,10 @@ bool Client::Impl::ReadBlock(InputStream& input, Block* block) {
 
     CreateColumnByTypeSettings create_column_settings;
     create_column_settings.low_cardinality_as_wrapped_column = options_.backward_compatibility_lowcardinality_as_wrapped_column;
+    create_column_settings.contiguous_strings = options_.contiguous_strings;
+
+    // Projection applies to the result of the query only.
+    const auto* projection = packet_type == ServerCodes::Data ? column_projection_ : nullptr;
 
     for (size_t i = 0; i < num_columns; ++i) {
         std::string name;
@@ -656,7 +950,28 @@ bool Client::Impl::ReadBlock(InputStream& input, Block* block) {
             }
         }  
 
-        if (ColumnRef col = CreateColumnByType(type, create_column_settings)) {
+        if (projection && !projection->count(name)) {
+            // Skipped data isn't kept, so one column per type does for all blocks.
+            ColumnRef& col = skipped_columns_[type];
+            if (!col) {
+                col = CreateColumnByType(type, create_column_settings);
+            }
+            if (!col) {
+                skipped_columns_.erase(type);
+                throw UnimplementedError(std::string("unsupported column type: ") + type);
+            }
+            if (num_rows && !col->Skip(&input, num_rows)) {
+                throw ProtocolError("can't skip column '" + name + "' of type " + type);
+            }
+            // Columns without own SkipBody() load the data instead.
+            if (col->Size()) {
+                col->Clear();
+            }
+            continue;
+        }
+
+        if (ColumnRef col = CreateColumn(packet_type, i, type, create_column_settings)) {
+
             if (num_rows && !col->Load(&input, num_rows)) {
                 throw ProtocolError("can't load column '" + name + "' of type " + type);
             }
@@ -670,7 +985,7 @@ bool Client::Impl::ReadBlock(InputStream& input, Block* block) {
     return true;
 }
 
-bool Client::Impl::ReceiveData() {
+bool Client::Impl::ReceiveData(Block* received_data) {
     Block block;
 
     if (server_info_.revision >= DBMS_MIN_REVISION_WITH_TEMPORARY_TABLES) {
@@ -680,12 +995,12 @@ bool Client::Impl::ReceiveData() {
     }
 
     if (compression_ == CompressionState::Enable) {
-        CompressedInput compressed(input_.get());
-        if (!ReadBlock(compressed, &block)) {
+        CompressedInput compressed(input_.get(), options_.zero_copy_strings, compression_pool_.get(), &compression_contexts_);
+        if (!ReadBlock(compressed, &block, ServerCodes::Data)) {
             return false;
         }
     } else {
-        if (!ReadBlock(*input_, &block)) {
+        if (!ReadBlock(*input_, &block, ServerCodes::Data)) {
             return false;
         }
     }
@@ -697,6 +1012,10 @@ bool Client::Impl::ReceiveData() {
         }
     }
 
+    if (received_data) {
+        *received_data = std::move(block);
+    }
+
     return true;
 }
 
@@ -737,6 +1056,9 @@ bool Client::Impl::ReceiveException(bool rethrow) {
         }
     } while (true);
 
+    // Exception ends the response as well.
+    ShrinkReadBuffer();
+
     if (events_) {
         events_->OnServerException(*e);
     }
@@ -908,7 +1230,9 @@ void Client::Impl::SendData(const Block& block) {
 
     if (compression_ == CompressionState::Enable) {
 
-        std::unique_ptr<OutputStream> compressed_output = std::make_unique<CompressedOutput>(output_.get(), options_.max_compression_chunk_size, options_.compression_method);
+        std::unique_ptr<OutputStream> compressed_output = std::make_unique<CompressedOutput>(
+            output_.get(), options_.max_compression_chunk_size, options_.compression_method, options_.compression_level,
+            compression_pool_.get(), &compression_contexts_, &compression_stats_);
         BufferedOutput buffered(std::move(compressed_output), options_.max_compression_chunk_size);
 
         WriteBlock(block, buffered);
@@ -920,14 +1244,27 @@ void Client::Impl::SendData(const Block& block) {
 }
 
 void Client::Impl::InitializeStreams(std::unique_ptr<SocketBase>&& socket) {
-    std::unique_ptr<OutputStream> output = std::make_unique<BufferedOutput>(socket->makeOutputStream());
-    std::unique_ptr<InputStream> input = std::make_unique<BufferedInput>(socket->makeInputStream());
+    std::unique_ptr<OutputStream> output = std::make_unique<BufferedOutput>(socket->makeOutputStream(), options_.write_buffer_size);
+    std::unique_ptr<InputStream> input = std::make_unique<BufferedInput>(socket->makeInputStream(), options_.read_buffer_size, options_.max_read_buffer_size);
 
     std::swap(input, input_);
     std::swap(output, output_);
     std::swap(socket, socket_);
 }
 
+void Client::Impl::EnsureIdle() const {
+    if (insert_query_) {
+        throw ValidationError("cannot execute query while inserting, call EndInsert() first");
+    }
+    if (receiving_in_background_) {
+        throw ValidationError("cannot execute query while result of another one is being received");
+    }
+}
+
+bool Client::Impl::IsIdle() const {
+    return !insert_query_ && !receiving_in_background_;
+}
+
 bool Client::Impl::SendHello() {
     WireFormat::WriteUInt64(*output_, ClientCodes::Hello);
     WireFormat::WriteString(*output_, std::string(DBMS_NAME) + " client");
@@ -1037,6 +1374,31 @@ void Client::Impl::RetryGuard(std::function<void()> func) {
     }
 }
 
+ResultCursor::ResultCursor(std::unique_ptr<Impl> impl)
+    : impl_(std::move(impl))
+{
+}
+
+ResultCursor::ResultCursor(ResultCursor&&) noexcept = default;
+
+ResultCursor& ResultCursor::operator=(ResultCursor&&) noexcept = default;
+
+ResultCursor::~ResultCursor() = default;
+
+bool ResultCursor::Next(Block& block) {
+    if (!impl_) {
+        throw ValidationError("cursor has been moved from");
+    }
+    return impl_->Next(block);
+}
+
+void ResultCursor::Cancel() {
+    if (!impl_) {
+        throw ValidationError("cursor has been moved from");
+    }
+    impl_->Cancel();
+}
+
 Client::Client(const ClientOptions& opts)
     : options_(opts)
     , impl_(new Impl(opts))
@@ -1077,6 +1439,10 @@ void Client::Select(const Query& query) {
     Execute(query);
 }
 
+ResultCursor Client::SelectCursor(const Query& query, size_t max_blocks_ahead) {
+    return ResultCursor(std::make_unique<ResultCursor::Impl>(impl_.get(), query, max_blocks_ahead));
+}
+
 void Client::Insert(const std::string& table_name, const Block& block) {
     impl_->Insert(table_name, Query::default_query_id, block);
 }
@@ -1085,6 +1451,18 @@ void Client::Insert(const std::string& table_name, const std::string& query_id,
     impl_->Insert(table_name, query_id, block);
 }
 
+Block Client::BeginInsert(const Query& query) {
+    return impl_->BeginInsert(query);
+}
+
+void Client::SendInsertBlock(const Block& block) {
+    impl_->SendInsertBlock(block);
+}
+
+void Client::EndInsert() {
+    impl_->EndInsert();
+}
+
 void Client::Ping() {
     impl_->Ping();
 }
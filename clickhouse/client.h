@@ -44,6 +44,10 @@ enum class CompressionMethod : int8_t {
     None = -1,
     LZ4  = 1,
     ZSTD = 2,
+    /// Slower LZ4 compression with higher ratio, data is decompressed as LZ4.
+    LZ4HC = 3,
+    /// Chooses for each chunk between LZ4, ZSTD and no compression by measured ratio, CPU time and send speed.
+    Adaptive = 4,
 };
 
 struct Endpoint {
@@ -102,6 +106,11 @@ struct ClientOptions {
     /// Compression method.
     DECLARE_FIELD(compression_method, CompressionMethod, SetCompressionMethod, CompressionMethod::None);
 
+    /** Level of ZSTD (also within Adaptive) or LZ4HC compression, 0 means the default one: 1 for ZSTD, 9 for LZ4HC.
+     *  Higher levels make data smaller at the cost of CPU. Ignored by LZ4.
+     */
+    DECLARE_FIELD(compression_level, int, SetCompressionLevel, 0);
+
     /// TCP Keep alive options
     DECLARE_FIELD(tcp_keepalive, bool, TcpKeepAlive, false);
     DECLARE_FIELD(tcp_keepalive_idle, std::chrono::seconds, SetTcpKeepAliveIdle, std::chrono::seconds(60));
@@ -135,6 +144,59 @@ struct ClientOptions {
      */
     DECLARE_FIELD(max_compression_chunk_size, unsigned int, SetMaxCompressionChunkSize, 65535);
 
+    /** If greater than 1, chunks of inserted data are compressed concurrently by that many threads,
+     *  the calling one included. Received frames needed by large reads, e.g. of numeric columns,
+     *  are read ahead and decompressed concurrently by the other threads, which are owned by the Client.
+     */
+    DECLARE_FIELD(compression_threads, size_t, SetCompressionThreads, 0);
+
+    /// Sizes of the buffers between the connection socket and the protocol.
+    DECLARE_FIELD(read_buffer_size, size_t, SetReadBufferSize, 8192);
+    DECLARE_FIELD(write_buffer_size, size_t, SetWriteBufferSize, 8192);
+
+    /** If greater than read_buffer_size, the read buffer grows up to this size while data keeps
+     *  arriving faster than it's consumed, e.g. during a large select, so fewer reads from
+     *  the socket are made. The buffer shrinks back to read_buffer_size once reads get small
+     *  or the response to the query is over, so idle connections don't keep large buffers.
+     */
+    DECLARE_FIELD(max_read_buffer_size, size_t, SetMaxReadBufferSize, 0);
+
+    /** If not zero, result of a query is received, decompressed and decoded by a separate thread,
+     *  which runs ahead of the data handlers by at most that many blocks.
+     *  Handlers of the query are still invoked on the calling thread, in order of arrival.
+     *
+     *  Helps when handlers spend as much time on a block as decoding of it takes.
+     */
+    DECLARE_FIELD(receive_ahead_blocks, size_t, SetReceiveAheadBlocks, 0);
+
+    /** Reuses columns of the previously received block for the next block of a query,
+     *  if the column at the same position has the same type. Columns keep their allocated
+     *  memory, so receiving of many blocks doesn't allocate it again for each of them.
+     *
+     *  Only columns which are not referenced outside of the client are reused,
+     *  hence it's safe to keep received blocks, but then there is no gain.
+     */
+    DECLARE_FIELD(recycle_blocks, bool, SetRecycleBlocks, false);
+
+    /** If compression is enabled, values of String columns of received blocks point right into
+     *  the decompressed data instead of being copied. Each such column keeps the decompressed chunks
+     *  it references alive, i.e. including data of other columns of the block.
+     */
+    DECLARE_FIELD(zero_copy_strings, bool, SetZeroCopyStrings, false);
+
+    /** String columns of received blocks keep all their values in a single buffer along with offsets
+     *  of their ends, see ColumnString::Storage::Contiguous. Values are always copied then,
+     *  so zero_copy_strings has no effect on them.
+     */
+    DECLARE_FIELD(contiguous_strings, bool, SetContiguousStrings, false);
+
+    /** If compression is disabled, pieces of inserted data not smaller than this size (at least 64 KiB),
+     *  which don't fit into the write buffer, are sent with MSG_ZEROCOPY, so the kernel reads them right from the columns instead of copying
+     *  into the socket buffer. Insert() returns only after the kernel has finished with the data.
+     *  0 disables, works on Linux only.
+     */
+    DECLARE_FIELD(zero_copy_send_threshold, size_t, SetZeroCopySendThreshold, 0);
+
     struct SSLOptions {
         /** There are two ways to configure an SSL connection:
          *  - provide a pre-configured SSL_CTX, which is not modified and not owned by the Client.
@@ -217,6 +279,14 @@ struct ClientOptions {
     // Will throw an exception if client was built without SSL support.
     ClientOptions& SetSSLOptions(SSLOptions options);
 
+    /** Perform socket IO through io_uring instead of plain system calls, on Linux only.
+     *  Ignored for SSL connections.
+     */
+    bool use_io_uring = false;
+
+    // Will throw an exception if client was built without io_uring support (WITH_IO_URING).
+    ClientOptions& SetUseIoUring(bool value);
+
 #undef DECLARE_FIELD
 };
 
@@ -225,6 +295,39 @@ std::ostream& operator<<(std::ostream& os, const Endpoint& options);
 
 class SocketFactory;
 
+/**
+ * Pull-based reader of the result of a select query, created by Client::SelectCursor().
+ *
+ * Blocks are received and decoded by a background thread at most a fixed number of blocks
+ * ahead of the consumer; once that many blocks are waiting, the socket is not read
+ * until the consumer catches up, so the server is throttled by TCP flow control.
+ *
+ * The client can't execute other queries while cursor exists and must outlive it.
+ */
+class ResultCursor {
+public:
+    ResultCursor(ResultCursor&&) noexcept;
+    ResultCursor& operator=(ResultCursor&&) noexcept;
+    /// Cancels the query if not all blocks are read and waits for the server to finish it.
+    ~ResultCursor();
+
+    /** Waits for the next non-empty block of data, returns false once all blocks are read.
+     *  Throws an exception if query has failed, ValidationError if the cursor has been moved from.
+     */
+    bool Next(Block& block);
+
+    /// Discards blocks read ahead and requests the server to stop sending data, throws ValidationError if the cursor has been moved from.
+    void Cancel();
+
+private:
+    friend class Client;
+
+    class Impl;
+    explicit ResultCursor(std::unique_ptr<Impl> impl);
+
+    std::unique_ptr<Impl> impl_;
+};
+
 /**
  *
  */
@@ -251,10 +354,30 @@ public:
     /// Alias for Execute.
     void Select(const Query& query);
 
+    /** Starts a select query which result is read block by block with ResultCursor::Next(),
+     *  at most \p max_blocks_ahead blocks are received before the consumer asks for them.
+     */
+    ResultCursor SelectCursor(const Query& query, size_t max_blocks_ahead = 4);
+
     /// Intends for insert block of data into a table \p table_name.
     void Insert(const std::string& table_name, const Block& block);
     void Insert(const std::string& table_name, const std::string& query_id, const Block& block);
 
+    /** Starts an INSERT query which data is streamed with any number of SendInsertBlock() calls,
+     *  query text is expected to end with VALUES, i.e. "INSERT INTO table (a, b) VALUES".
+     *  Returns an empty block with names and types of columns expected by the server.
+     *  No other query can be executed by the client until EndInsert() is called.
+     */
+    Block BeginInsert(const Query& query);
+
+    /** Sends a block of data of the INSERT started with BeginInsert(), block is flushed to the server immediately,
+     *  so it may be modified or reused once the call returns. Small blocks are better merged into larger ones by the caller.
+     */
+    void SendInsertBlock(const Block& block);
+
+    /// Sends the end-of-data marker and waits for the server to finish the INSERT started with BeginInsert().
+    void EndInsert();
+
     /// Ping server for aliveness.
     void Ping();
 
@@ -282,6 +405,11 @@ public:
     static Version GetVersion();
 
 private:
+    friend class AsyncClient;
+    friend class ClientPool;
+    friend class ResultCursor;
+    friend class ReceivePipeline;
+
     const ClientOptions options_;
 
     class Impl;
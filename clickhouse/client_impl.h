@@ -0,0 +1,186 @@
+#pragma once
+
+#include "client.h"
+#include "protocol.h"
+
+#include "base/compressed.h"
+#include "base/endpoints_iterator.h"
+#include "base/input.h"
+#include "base/output.h"
+#include "base/socket.h"
+#include "base/thread_pool.h"
+
+#include "columns/factory.h"
+
+#include <functional>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+/// Internal header, not a part of the public API.
+
+namespace clickhouse {
+
+/// Text of the INSERT query for columns of the block.
+std::string MakeInsertQuery(const std::string& table_name, const Block& block);
+
+class Client::Impl {
+public:
+     Impl(const ClientOptions& opts);
+     Impl(const ClientOptions& opts,
+          std::unique_ptr<SocketFactory> socket_factory);
+    ~Impl();
+
+    void ExecuteQuery(Query query);
+
+    void SendCancel();
+
+    void Insert(const std::string& table_name, const std::string& query_id, const Block& block);
+
+    Block BeginInsert(Query query);
+
+    void SendInsertBlock(const Block& block);
+
+    void EndInsert();
+
+    void Ping();
+
+    void ResetConnection();
+
+    void ResetConnectionEndpoint();
+
+    const ServerInfo& GetServerInfo() const;
+
+    const std::optional<Endpoint>& GetCurrentEndpoint() const;
+
+    /// Socket of the current connection.
+    SocketBase* GetSocket() const;
+
+    /// Replaces streams on top of the socket, i.e. to drive the protocol without blocking IO.
+    void ReplaceStreams(std::unique_ptr<InputStream> input, std::unique_ptr<OutputStream> output);
+
+private:
+    friend class AsyncClient;
+    friend class ClientPool;
+    friend class ReceivePipeline;
+
+    /// Executes query without checking whether the client is busy and without pinging the server first.
+    void DoExecuteQuery(const Query& query, QueryEvents* events);
+
+    void DoPing();
+
+    bool Handshake();
+
+    bool ReceivePacket(uint64_t* server_packet = nullptr, Block* received_data = nullptr);
+
+    void SendQuery(const Query& query);
+
+    void SendData(const Block& block);
+
+    bool SendHello();
+
+    /// Reads a block of the packet of \p packet_type, columns of data blocks which aren't in the projection of the query are skipped.
+    bool ReadBlock(InputStream& input, Block* block, uint64_t packet_type);
+
+    /// Returns empty column of the given type, reusing a column of the previous block of the same packet type if possible.
+    ColumnRef CreateColumn(uint64_t packet_type, size_t position, const std::string& type, const CreateColumnByTypeSettings& settings);
+
+    bool ReceiveHello();
+
+    /// Reads data packet form input stream.
+    bool ReceiveData(Block* received_data = nullptr);
+
+    /// Reads exception packet form input stream.
+    bool ReceiveException(bool rethrow = false);
+
+    /// Returns the read buffer grown during a response to its initial size, once the response is over.
+    void ShrinkReadBuffer();
+
+    void WriteBlock(const Block& block, OutputStream& output);
+
+    void CreateConnection();
+
+    void InitializeStreams(std::unique_ptr<SocketBase>&& socket);
+
+    /// Throws if an INSERT started with BeginInsert() or a result cursor is in progress.
+    void EnsureIdle() const;
+
+    /// False if an INSERT started with BeginInsert() or a result cursor is in progress.
+    bool IsIdle() const;
+
+    inline size_t GetConnectionAttempts() const
+    {
+        return options_.endpoints.size() * options_.send_retries;
+    }
+
+private:
+    /// In case of network errors tries to reconnect to server and
+    /// call fuc several times.
+    void RetryGuard(std::function<void()> func);
+
+    void RetryConnectToTheEndpoint(std::function<void()>& func);
+
+private:
+    /// Resets pointer to the current state of the query when it is finished.
+    template <typename T>
+    class EnsureNull {
+    public:
+        inline EnsureNull(T* value, T** ptr)
+            : ptr_(ptr)
+        {
+            if (ptr_) {
+                *ptr_ = value;
+            }
+        }
+
+        inline ~EnsureNull() {
+            if (ptr_) {
+                *ptr_ = nullptr;
+            }
+        }
+
+    private:
+        T** ptr_;
+
+    };
+
+
+    const ClientOptions options_;
+    QueryEvents* events_;
+    /// Columns to decode of the current query, others are skipped.
+    const std::unordered_set<std::string>* column_projection_ = nullptr;
+    int compression_ = CompressionState::Disable;
+
+    /// Query of the INSERT started with BeginInsert(), set until EndInsert() is called.
+    std::unique_ptr<Query> insert_query_;
+
+    /// Set while result of a query is received by a separate thread.
+    bool receiving_in_background_ = false;
+
+    /// Columns of the last received block of each packet type with their types, which may be reused for the next one.
+    std::unordered_map<uint64_t, std::vector<std::pair<std::string, ColumnRef>>> recycled_columns_;
+    /// Columns used to skip data of the types left out by the projection of the current query.
+    std::unordered_map<std::string, ColumnRef> skipped_columns_;
+
+    /// Must outlive tasks of the compression pool.
+    CompressionContextPool compression_contexts_;
+    AdaptiveCompressionStats compression_stats_;
+    /// Workers compressing and decompressing data, see ClientOptions::compression_threads.
+    std::unique_ptr<ThreadPool> compression_pool_;
+
+    std::unique_ptr<SocketFactory> socket_factory_;
+
+    std::unique_ptr<InputStream> input_;
+    std::unique_ptr<OutputStream> output_;
+    std::unique_ptr<SocketBase> socket_;
+    std::unique_ptr<EndpointsIteratorBase> endpoints_iterator;
+
+    std::optional<Endpoint> current_endpoint_;
+
+    ServerInfo server_info_;
+};
+
+}
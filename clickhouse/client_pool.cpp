@@ -0,0 +1,458 @@
+#include "client_pool.h"
+#include "client_impl.h"
+
+#include "base/socket.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <iterator>
+#include <mutex>
+#include <thread>
+
+namespace clickhouse {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+}
+
+struct ClientPool::Connection {
+    size_t endpoint_index;
+    std::unique_ptr<Client> client;
+    Clock::time_point last_used;
+};
+
+struct ClientPool::Impl {
+    struct EndpointState {
+        Endpoint endpoint;
+        ClientOptions options;
+        /// Least recently used connection is in front, Acquire() takes from the back.
+        std::deque<std::unique_ptr<Connection>> idle;
+        size_t leased = 0;
+        size_t connecting = 0;
+        size_t failures = 0;
+        Clock::time_point retry_at;
+
+        size_t Total() const {
+            return idle.size() + leased + connecting;
+        }
+
+        bool Healthy() const {
+            return failures == 0;
+        }
+    };
+
+    Impl(const ClientOptions& opts, const ClientPoolOptions& pool_opts, SocketFactoryMaker socket_factory_maker);
+
+    void Start();
+    void Stop();
+
+    std::unique_ptr<Connection> Acquire(std::chrono::milliseconds timeout);
+    /// Connection is closed instead of being pooled unless \p reuse is set and its client is idle.
+    void Return(std::unique_ptr<Connection> connection, bool reuse);
+
+    std::vector<ClientPoolEndpointStatus> GetEndpointsStatus() const;
+
+    /// All methods below expect mutex_ to be locked, which is released for the duration of network calls.
+    std::unique_ptr<Connection> TakeIdle(std::unique_lock<std::mutex>& lock, size_t index);
+    std::unique_ptr<Connection> Connect(std::unique_lock<std::mutex>& lock, size_t index);
+    bool Validate(std::unique_lock<std::mutex>& lock, Connection& connection);
+    void Drop(std::unique_lock<std::mutex>& lock, std::unique_ptr<Connection> connection);
+    bool IsStale(const Connection& connection, Clock::time_point now) const;
+    void MaintainEndpoint(std::unique_lock<std::mutex>& lock, size_t index);
+    void MaintenanceLoop();
+
+    const ClientPoolOptions pool_options_;
+    const SocketFactoryMaker socket_factory_maker_;
+    const size_t max_connections_;
+
+    mutable std::mutex mutex_;
+    /// Signaled when connection is returned to the pool or state of an endpoint is changed.
+    std::condition_variable returned_;
+    std::condition_variable wakeup_;
+    std::vector<EndpointState> endpoints_;
+    size_t next_endpoint_ = 0;
+    std::exception_ptr last_error_;
+    bool stopped_ = false;
+    std::thread maintenance_;
+};
+
+ClientPool::Impl::Impl(const ClientOptions& opts, const ClientPoolOptions& pool_opts, SocketFactoryMaker socket_factory_maker)
+    : pool_options_(pool_opts)
+    , socket_factory_maker_(std::move(socket_factory_maker))
+    , max_connections_(std::max(pool_opts.connections_per_endpoint, pool_opts.max_connections_per_endpoint))
+{
+    if (max_connections_ == 0) {
+        throw ValidationError("max number of connections per endpoint must be positive");
+    }
+
+    std::vector<Endpoint> endpoints;
+    if (!opts.host.empty()) {
+        endpoints.push_back(Endpoint{opts.host, opts.port});
+    }
+    endpoints.insert(endpoints.end(), opts.endpoints.begin(), opts.endpoints.end());
+
+    if (endpoints.empty()) {
+        throw ValidationError("The list of endpoints is empty");
+    }
+
+    endpoints_ = std::vector<EndpointState>(endpoints.size());
+    for (size_t i = 0; i < endpoints.size(); ++i) {
+        auto& ep = endpoints_[i];
+        ep.endpoint = endpoints[i];
+        // Each client of the pool is bound to the single endpoint, failover is done by the pool itself.
+        ep.options = opts;
+        ep.options.SetHost(ep.endpoint.host).SetPort(ep.endpoint.port).SetEndpoints({});
+    }
+}
+
+void ClientPool::Impl::Start() {
+    maintenance_ = std::thread([this] { MaintenanceLoop(); });
+}
+
+void ClientPool::Impl::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopped_ = true;
+    }
+    wakeup_.notify_all();
+    returned_.notify_all();
+
+    if (maintenance_.joinable()) {
+        maintenance_.join();
+    }
+
+    std::vector<std::unique_ptr<Connection>> idle;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& ep : endpoints_) {
+            std::move(ep.idle.begin(), ep.idle.end(), std::back_inserter(idle));
+            ep.idle.clear();
+        }
+    }
+}
+
+std::unique_ptr<ClientPool::Connection> ClientPool::Impl::Acquire(std::chrono::milliseconds timeout) {
+    const auto deadline = Clock::now() + timeout;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        if (stopped_) {
+            throw ValidationError("connection pool is stopped");
+        }
+
+        const size_t count = endpoints_.size();
+
+        // Idle connections go first, they cost nothing.
+        for (size_t i = 0; i < count; ++i) {
+            const size_t index = (next_endpoint_ + i) % count;
+            if (auto connection = TakeIdle(lock, index)) {
+                next_endpoint_ = index + 1;
+                return connection;
+            }
+        }
+
+        // Open a new connection to an endpoint which has not reached the limit yet,
+        // endpoints which failed recently are left to the background thread.
+        for (size_t i = 0; i < count; ++i) {
+            const size_t index = (next_endpoint_ + i) % count;
+            auto& ep = endpoints_[index];
+            if (!ep.Healthy() || ep.Total() >= max_connections_) {
+                continue;
+            }
+
+            if (auto connection = Connect(lock, index)) {
+                next_endpoint_ = index + 1;
+                ++ep.leased;
+                return connection;
+            }
+        }
+
+        // Fail fast if no connection can ever be returned to the pool.
+        const bool unreachable = std::all_of(endpoints_.begin(), endpoints_.end(), [] (const EndpointState& ep) {
+            return !ep.Healthy() && ep.Total() == 0;
+        });
+        if (unreachable && last_error_) {
+            std::rethrow_exception(last_error_);
+        }
+
+        if (returned_.wait_until(lock, deadline) == std::cv_status::timeout) {
+            if (last_error_ && std::none_of(endpoints_.begin(), endpoints_.end(),
+                    [] (const EndpointState& ep) { return ep.Healthy(); })) {
+                std::rethrow_exception(last_error_);
+            }
+            throw ProtocolError("timeout while waiting for a free connection in the pool");
+        }
+    }
+}
+
+void ClientPool::Impl::Return(std::unique_ptr<Connection> connection, bool reuse) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto& ep = endpoints_[connection->endpoint_index];
+    --ep.leased;
+
+    // Client left in the middle of a query would fail every call of the next lease.
+    if (reuse && !stopped_ && connection->client->impl_->IsIdle()) {
+        connection->last_used = Clock::now();
+        ep.idle.push_back(std::move(connection));
+        returned_.notify_one();
+        return;
+    }
+
+    // Let waiters open a new connection instead and the background thread refill the pool.
+    returned_.notify_one();
+    wakeup_.notify_one();
+    Drop(lock, std::move(connection));
+}
+
+std::vector<ClientPoolEndpointStatus> ClientPool::Impl::GetEndpointsStatus() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    std::vector<ClientPoolEndpointStatus> result;
+    result.reserve(endpoints_.size());
+    for (const auto& ep : endpoints_) {
+        result.push_back(ClientPoolEndpointStatus{ep.endpoint, ep.Healthy(), ep.idle.size(), ep.leased, ep.failures});
+    }
+    return result;
+}
+
+std::unique_ptr<ClientPool::Connection> ClientPool::Impl::TakeIdle(std::unique_lock<std::mutex>& lock, size_t index) {
+    auto& ep = endpoints_[index];
+
+    while (!ep.idle.empty()) {
+        auto connection = std::move(ep.idle.back());
+        ep.idle.pop_back();
+        ++ep.leased;
+
+        if (!IsStale(*connection, Clock::now()) || Validate(lock, *connection)) {
+            return connection;
+        }
+
+        --ep.leased;
+        wakeup_.notify_one();
+        Drop(lock, std::move(connection));
+    }
+
+    return nullptr;
+}
+
+std::unique_ptr<ClientPool::Connection> ClientPool::Impl::Connect(std::unique_lock<std::mutex>& lock, size_t index) {
+    auto& ep = endpoints_[index];
+    ++ep.connecting;
+    lock.unlock();
+
+    std::unique_ptr<Client> client;
+    std::exception_ptr error;
+    try {
+        if (socket_factory_maker_) {
+            client = std::make_unique<Client>(ep.options, socket_factory_maker_());
+        } else {
+            client = std::make_unique<Client>(ep.options);
+        }
+    } catch (...) {
+        error = std::current_exception();
+    }
+
+    lock.lock();
+    --ep.connecting;
+
+    if (error) {
+        const auto backoff = std::min(
+            pool_options_.reconnect_backoff * (1u << std::min<size_t>(ep.failures, 16)),
+            pool_options_.max_reconnect_backoff);
+
+        ++ep.failures;
+        ep.retry_at = Clock::now() + backoff;
+        last_error_ = error;
+        returned_.notify_all();
+        return nullptr;
+    }
+
+    if (!ep.Healthy()) {
+        ep.failures = 0;
+        returned_.notify_all();
+    }
+
+    return std::unique_ptr<Connection>(new Connection{index, std::move(client), Clock::now()});
+}
+
+bool ClientPool::Impl::Validate(std::unique_lock<std::mutex>& lock, Connection& connection) {
+    lock.unlock();
+
+    bool ok = true;
+    try {
+        connection.client->Ping();
+    } catch (...) {
+        ok = false;
+    }
+
+    lock.lock();
+    if (ok) {
+        connection.last_used = Clock::now();
+    }
+    return ok;
+}
+
+void ClientPool::Impl::Drop(std::unique_lock<std::mutex>& lock, std::unique_ptr<Connection> connection) {
+    // Closing the socket may take a while, don't block other threads on that.
+    lock.unlock();
+    connection.reset();
+    lock.lock();
+}
+
+bool ClientPool::Impl::IsStale(const Connection& connection, Clock::time_point now) const {
+    return now - connection.last_used > pool_options_.validate_after_idle;
+}
+
+void ClientPool::Impl::MaintainEndpoint(std::unique_lock<std::mutex>& lock, size_t index) {
+    auto& ep = endpoints_[index];
+
+    // Close connections opened above connections_per_endpoint once they are not needed anymore,
+    // ping the rest of idle connections to keep them alive.
+    size_t to_check = ep.idle.size();
+    while (!stopped_ && to_check-- > 0 && !ep.idle.empty() && IsStale(*ep.idle.front(), Clock::now())) {
+        auto connection = std::move(ep.idle.front());
+        ep.idle.pop_front();
+
+        if (ep.Total() >= pool_options_.connections_per_endpoint) {
+            Drop(lock, std::move(connection));
+            continue;
+        }
+
+        ++ep.leased;
+        const bool ok = Validate(lock, *connection);
+        --ep.leased;
+
+        if (ok) {
+            ep.idle.push_back(std::move(connection));
+            returned_.notify_one();
+        } else {
+            Drop(lock, std::move(connection));
+        }
+    }
+
+    while (!stopped_ && ep.Total() < pool_options_.connections_per_endpoint
+           && (ep.Healthy() || Clock::now() >= ep.retry_at))
+    {
+        auto connection = Connect(lock, index);
+        if (!connection) {
+            break;
+        }
+
+        ep.idle.push_back(std::move(connection));
+        returned_.notify_one();
+    }
+}
+
+void ClientPool::Impl::MaintenanceLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    while (!stopped_) {
+        for (size_t index = 0; index < endpoints_.size() && !stopped_; ++index) {
+            MaintainEndpoint(lock, index);
+        }
+
+        if (!stopped_) {
+            wakeup_.wait_for(lock, pool_options_.maintenance_interval);
+        }
+    }
+}
+
+
+ClientPool::Lease::Lease(std::shared_ptr<Impl> pool, std::unique_ptr<Connection> connection)
+    : pool_(std::move(pool))
+    , connection_(std::move(connection))
+    , uncaught_exceptions_(std::uncaught_exceptions())
+{
+}
+
+ClientPool::Lease::Lease(Lease&& other) noexcept
+    : pool_(std::move(other.pool_))
+    , connection_(std::move(other.connection_))
+    , invalidated_(other.invalidated_)
+    , uncaught_exceptions_(other.uncaught_exceptions_)
+{
+}
+
+ClientPool::Lease& ClientPool::Lease::operator=(Lease&& other) noexcept {
+    if (this != &other) {
+        Release();
+
+        pool_ = std::move(other.pool_);
+        connection_ = std::move(other.connection_);
+        invalidated_ = other.invalidated_;
+        uncaught_exceptions_ = other.uncaught_exceptions_;
+    }
+    return *this;
+}
+
+ClientPool::Lease::~Lease() {
+    Release();
+}
+
+Client& ClientPool::Lease::operator*() const {
+    return *operator->();
+}
+
+Client* ClientPool::Lease::operator->() const {
+    if (!connection_) {
+        throw ValidationError("connection is already returned to the pool");
+    }
+    return connection_->client.get();
+}
+
+const Endpoint& ClientPool::Lease::GetEndpoint() const {
+    if (!connection_) {
+        throw ValidationError("connection is already returned to the pool");
+    }
+    return connection_->client->GetCurrentEndpoint().value();
+}
+
+void ClientPool::Lease::Invalidate() {
+    invalidated_ = true;
+}
+
+void ClientPool::Lease::Release() {
+    if (!connection_) {
+        return;
+    }
+
+    // Connection which was in use when exception was thrown may have unread data in the socket.
+    const bool reuse = !invalidated_ && std::uncaught_exceptions() <= uncaught_exceptions_;
+
+    pool_->Return(std::move(connection_), reuse);
+    pool_.reset();
+}
+
+
+ClientPool::ClientPool(const ClientOptions& opts, const ClientPoolOptions& pool_opts)
+    : ClientPool(opts, pool_opts, SocketFactoryMaker())
+{
+}
+
+ClientPool::ClientPool(const ClientOptions& opts, const ClientPoolOptions& pool_opts, SocketFactoryMaker socket_factory_maker)
+    : impl_(std::make_shared<Impl>(opts, pool_opts, std::move(socket_factory_maker)))
+{
+    impl_->Start();
+}
+
+ClientPool::~ClientPool() {
+    impl_->Stop();
+}
+
+ClientPool::Lease ClientPool::Acquire() {
+    return Acquire(impl_->pool_options_.acquire_timeout);
+}
+
+ClientPool::Lease ClientPool::Acquire(std::chrono::milliseconds timeout) {
+    return Lease(impl_, impl_->Acquire(timeout));
+}
+
+std::vector<ClientPoolEndpointStatus> ClientPool::GetEndpointsStatus() const {
+    return impl_->GetEndpointsStatus();
+}
+
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include "client.h"
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace clickhouse {
+
+struct ClientPoolOptions {
+#define DECLARE_FIELD(name, type, setter, default_value) \
+    inline auto & setter(const type& value) { \
+        name = value; \
+        return *this; \
+    } \
+    type name = default_value
+
+    /// Number of connections the pool keeps open to each endpoint, re-established in background when lost.
+    DECLARE_FIELD(connections_per_endpoint, size_t, SetConnectionsPerEndpoint, 4);
+
+    /** Max number of connections (leased and idle) to each endpoint.
+     *  When all warm connections are leased, extra ones are opened on demand up to that limit.
+     *  Zero means the same value as connections_per_endpoint.
+     */
+    DECLARE_FIELD(max_connections_per_endpoint, size_t, SetMaxConnectionsPerEndpoint, 0);
+
+    /// Connection which has been idle for longer than that is pinged before being leased.
+    DECLARE_FIELD(validate_after_idle, std::chrono::milliseconds, SetValidateAfterIdle, std::chrono::seconds(5));
+
+    /// Max amount of time Acquire() waits for a free connection.
+    DECLARE_FIELD(acquire_timeout, std::chrono::milliseconds, SetAcquireTimeout, std::chrono::seconds(5));
+
+    /// Interval of the background checks: refilling the pool, pinging idle connections, retrying failed endpoints.
+    DECLARE_FIELD(maintenance_interval, std::chrono::milliseconds, SetMaintenanceInterval, std::chrono::seconds(1));
+
+    /** Endpoint which failed to connect is not used for new connections for that long,
+     *  delay is doubled on each consecutive failure, up to max_reconnect_backoff.
+     */
+    DECLARE_FIELD(reconnect_backoff, std::chrono::milliseconds, SetReconnectBackoff, std::chrono::milliseconds(500));
+    DECLARE_FIELD(max_reconnect_backoff, std::chrono::milliseconds, SetMaxReconnectBackoff, std::chrono::seconds(30));
+
+#undef DECLARE_FIELD
+};
+
+/// State of the endpoint as seen by the pool.
+struct ClientPoolEndpointStatus {
+    Endpoint endpoint;
+    /// False if last attempt to connect to the endpoint has failed.
+    bool healthy;
+    size_t idle;
+    size_t leased;
+    size_t consecutive_failures;
+};
+
+/**
+ * Thread-safe pool of connections to one or more endpoints.
+ *
+ * Each endpoint from ClientOptions (host+port and endpoints list) gets its own set of
+ * connections, which are opened in background and handed out with Acquire().
+ * Client is returned to the pool when the Lease is destroyed.
+ */
+class ClientPool {
+    struct Impl;
+    struct Connection;
+
+public:
+    using SocketFactoryMaker = std::function<std::unique_ptr<SocketFactory>()>;
+
+    /// RAII handle of the connection taken from the pool, movable but not copyable.
+    class Lease {
+    public:
+        Lease(Lease&& other) noexcept;
+        Lease& operator=(Lease&& other) noexcept;
+        ~Lease();
+
+        Client& operator*() const;
+        Client* operator->() const;
+
+        /// Endpoint the leased client is connected to.
+        const Endpoint& GetEndpoint() const;
+
+        /** Connection is closed instead of being returned to the pool.
+         *  Should be called when connection may be left in inconsistent state, i.e. query was interrupted.
+         *  That is done automatically if Lease is destroyed during stack unwinding.
+         */
+        void Invalidate();
+
+        /// Returns client to the pool before Lease is destroyed.
+        void Release();
+
+    private:
+        friend class ClientPool;
+        Lease(std::shared_ptr<Impl> pool, std::unique_ptr<Connection> connection);
+
+        std::shared_ptr<Impl> pool_;
+        std::unique_ptr<Connection> connection_;
+        bool invalidated_ = false;
+        int uncaught_exceptions_;
+    };
+
+    explicit ClientPool(const ClientOptions& opts, const ClientPoolOptions& pool_opts = ClientPoolOptions());
+    /// Each connection gets its own SocketFactory created by \p socket_factory_maker.
+    ClientPool(const ClientOptions& opts, const ClientPoolOptions& pool_opts, SocketFactoryMaker socket_factory_maker);
+    ~ClientPool();
+
+    ClientPool(const ClientPool&) = delete;
+    ClientPool& operator=(const ClientPool&) = delete;
+
+    /** Takes a connection from the pool, endpoints are used on the round-robin basis.
+     *  Opens new connection if there are no idle ones and limit allows that,
+     *  otherwise waits up to ClientPoolOptions::acquire_timeout for a connection to be returned.
+     *  Throws on timeout, rethrowing last connection error if no endpoint is reachable.
+     */
+    Lease Acquire();
+    Lease Acquire(std::chrono::milliseconds timeout);
+
+    std::vector<ClientPoolEndpointStatus> GetEndpointsStatus() const;
+
+private:
+    std::shared_ptr<Impl> impl_;
+};
+
+}
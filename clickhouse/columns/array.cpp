@@ -1,6 +1,9 @@
 #include "array.h"
 #include "numeric.h"
 
+#include "../base/input.h"
+#include "../base/wire_format.h"
+
 #include <stdexcept>
 
 namespace clickhouse {
@@ -90,6 +93,24 @@ bool ColumnArray::LoadBody(InputStream* input, size_t rows) {
     return true;
 }
 
+bool ColumnArray::SkipBody(InputStream* input, size_t rows) {
+    if (!rows) {
+        return true;
+    }
+    // Only the last offset is needed to know the number of nested rows.
+    if (!input->Skip((rows - 1) * sizeof(uint64_t))) {
+        return false;
+    }
+    uint64_t nested_rows;
+    if (!WireFormat::ReadFixed(*input, &nested_rows)) {
+        return false;
+    }
+    if (nested_rows == 0) {
+        return true;
+    }
+    return data_->SkipBody(input, nested_rows);
+}
+
 void ColumnArray::SavePrefix(OutputStream* output) {
     data_->SavePrefix(output);
 }
@@ -59,6 +59,9 @@ public:
     /// Loads column data from input stream.
     bool LoadBody(InputStream* input, size_t rows) override;
 
+    /// Skips column data in input stream.
+    bool SkipBody(InputStream* input, size_t rows) override;
+
     /// Saves column prefix to output stream.
     void SavePrefix(OutputStream* output) override;
 
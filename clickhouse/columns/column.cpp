@@ -11,6 +11,14 @@ bool Column::Load(InputStream* input, size_t rows) {
     return LoadPrefix(input, rows) && LoadBody(input, rows);
 }
 
+bool Column::Skip(InputStream* input, size_t rows) {
+    return LoadPrefix(input, rows) && SkipBody(input, rows);
+}
+
+bool Column::SkipBody(InputStream* input, size_t rows) {
+    return LoadBody(input, rows);
+}
+
 void Column::SavePrefix(OutputStream*) {
     /// does nothing by default
 }
@@ -65,6 +65,14 @@ public:
     /// Loads column data from input stream.
     virtual bool LoadBody(InputStream* input, size_t rows) = 0;
 
+    /// Template method to skip column data in input stream instead of loading it. It'll call LoadPrefix and SkipBody.
+    /// Content of the column is unspecified afterwards, so it is meant for columns which are discarded.
+    bool Skip(InputStream* input, size_t rows);
+
+    /// Skips column data in input stream. Loads data into the column by default,
+    /// derived classes override it to avoid decoding and allocations.
+    virtual bool SkipBody(InputStream* input, size_t rows);
+
     /// Saves column prefix to output stream. Column types with prefixes must implement it.
     virtual void SavePrefix(OutputStream* output);
 
@@ -59,6 +59,10 @@ bool ColumnDate::LoadBody(InputStream* input, size_t rows) {
     return data_->LoadBody(input, rows);
 }
 
+bool ColumnDate::SkipBody(InputStream* input, size_t rows) {
+    return data_->SkipBody(input, rows);
+}
+
 void ColumnDate::SaveBody(OutputStream* output) {
     data_->SaveBody(output);
 }
@@ -146,6 +150,10 @@ bool ColumnDate32::LoadBody(InputStream* input, size_t rows) {
     return data_->LoadBody(input, rows);
 }
 
+bool ColumnDate32::SkipBody(InputStream* input, size_t rows) {
+    return data_->SkipBody(input, rows);
+}
+
 void ColumnDate32::SaveBody(OutputStream* output) {
     data_->SaveBody(output);
 }
@@ -198,6 +206,11 @@ ColumnDateTime::ColumnDateTime(std::string timezone, std::vector<uint32_t>&& dat
     , data_(std::make_shared<ColumnUInt32>(std::move(data))) {
 }
 
+ColumnDateTime::ColumnDateTime(TypeRef type, std::shared_ptr<ColumnUInt32> data)
+    : Column(std::move(type))
+    , data_(std::move(data)) {
+}
+
 void ColumnDateTime::Append(const std::time_t& value) {
     data_->Append(static_cast<uint32_t>(value));
 }
@@ -240,6 +253,10 @@ bool ColumnDateTime::LoadBody(InputStream* input, size_t rows) {
     return data_->LoadBody(input, rows);
 }
 
+bool ColumnDateTime::SkipBody(InputStream* input, size_t rows) {
+    return data_->SkipBody(input, rows);
+}
+
 void ColumnDateTime::SaveBody(OutputStream* output) {
     data_->SaveBody(output);
 }
@@ -262,7 +279,8 @@ ColumnRef ColumnDateTime::Slice(size_t begin, size_t len) const {
 }
 
 ColumnRef ColumnDateTime::CloneEmpty() const {
-    return std::make_shared<ColumnDateTime>();
+    // couldn't use std::make_shared since this c-tor is private
+    return ColumnRef{new ColumnDateTime(type_, std::make_shared<ColumnUInt32>())};
 }
 
 void ColumnDateTime::Swap(Column& other) {
@@ -322,6 +340,10 @@ bool ColumnDateTime64::LoadBody(InputStream* input, size_t rows) {
     return data_->LoadBody(input, rows);
 }
 
+bool ColumnDateTime64::SkipBody(InputStream* input, size_t rows) {
+    return data_->SkipBody(input, rows);
+}
+
 void ColumnDateTime64::SaveBody(OutputStream* output) {
     data_->SaveBody(output);
 }
@@ -43,6 +43,9 @@ public:
     /// Loads column data from input stream.
     bool LoadBody(InputStream* input, size_t rows) override;
 
+    /// Skips column data in input stream.
+    bool SkipBody(InputStream* input, size_t rows) override;
+
     /// Saves column data to output stream.
     void SaveBody(OutputStream* output) override;
 
@@ -101,6 +104,9 @@ public:
     /// Loads column data from input stream.
     bool LoadBody(InputStream* input, size_t rows) override;
 
+    /// Skips column data in input stream.
+    bool SkipBody(InputStream* input, size_t rows) override;
+
     /// Saves column data to output stream.
     void SaveBody(OutputStream* output) override;
 
@@ -163,6 +169,9 @@ public:
     /// Loads column data from input stream.
     bool LoadBody(InputStream* input, size_t rows) override;
 
+    /// Skips column data in input stream.
+    bool SkipBody(InputStream* input, size_t rows) override;
+
     /// Clear column data .
     void Clear() override;
 
@@ -179,6 +188,9 @@ public:
 
     ItemView GetItem(size_t index) const override;
 
+private:
+    ColumnDateTime(TypeRef type, std::shared_ptr<ColumnUInt32> data);
+
 private:
     std::shared_ptr<ColumnUInt32> data_;
 };
@@ -216,6 +228,9 @@ public:
     /// Loads column data from input stream.
     bool LoadBody(InputStream* input, size_t rows) override;
 
+    /// Skips column data in input stream.
+    bool SkipBody(InputStream* input, size_t rows) override;
+
     /// Clear column data .
     void Clear() override;
 
@@ -205,6 +205,10 @@ bool ColumnDecimal::LoadBody(InputStream * input, size_t rows) {
     return data_->LoadBody(input, rows);
 }
 
+bool ColumnDecimal::SkipBody(InputStream* input, size_t rows) {
+    return data_->SkipBody(input, rows);
+}
+
 void ColumnDecimal::SaveBody(OutputStream* output) {
     data_->SaveBody(output);
 }
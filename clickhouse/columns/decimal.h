@@ -25,6 +25,9 @@ public:
     void Reserve(size_t new_cap) override;
     void Append(ColumnRef column) override;
     bool LoadBody(InputStream* input, size_t rows) override;
+
+    /// Skips column data in input stream.
+    bool SkipBody(InputStream* input, size_t rows) override;
     void SaveBody(OutputStream* output) override;
     void Clear() override;
     size_t Size() const override;
@@ -86,6 +86,11 @@ bool ColumnEnum<T>::LoadBody(InputStream* input, size_t rows) {
     return WireFormat::ReadBytes(*input, data_.data(), data_.size() * sizeof(T));
 }
 
+template <typename T>
+bool ColumnEnum<T>::SkipBody(InputStream* input, size_t rows) {
+    return input->Skip(rows * sizeof(T));
+}
+
 template <typename T>
 void ColumnEnum<T>::SaveBody(OutputStream* output) {
     WireFormat::WriteBytes(*output, data_.data(), data_.size() * sizeof(T));
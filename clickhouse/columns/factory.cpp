@@ -24,6 +24,7 @@
 
 #include <stdexcept>
 #include <string>
+#include <unordered_map>
 
 namespace clickhouse {
 namespace {
@@ -43,7 +44,7 @@ const auto& GetASTChildElement(const TypeAst & ast, int position) {
     return ast.elements[static_cast<size_t>(position)];
 }
 
-static ColumnRef CreateTerminalColumn(const TypeAst& ast) {
+static ColumnRef CreateTerminalColumn(const TypeAst& ast, const CreateColumnByTypeSettings& settings) {
     switch (ast.code) {
     case Type::Void:
         return std::make_shared<ColumnNothing>();
@@ -83,7 +84,8 @@ static ColumnRef CreateTerminalColumn(const TypeAst& ast) {
         return std::make_shared<ColumnDecimal>(38, GetASTChildElement(ast, 0).value);
 
     case Type::String:
-        return std::make_shared<ColumnString>();
+        return std::make_shared<ColumnString>(
+            settings.contiguous_strings ? ColumnString::Storage::Contiguous : ColumnString::Storage::Views);
     case Type::FixedString:
         return std::make_shared<ColumnFixedString>(GetASTChildElement(ast, 0).value);
 
@@ -148,7 +150,7 @@ static ColumnRef CreateColumnFromAst(const TypeAst& ast, CreateColumnByTypeSetti
         }
 
         case TypeAst::Terminal: {
-            return CreateTerminalColumn(ast);
+            return CreateTerminalColumn(ast, settings);
         }
 
         case TypeAst::Tuple: {
@@ -227,7 +229,7 @@ static ColumnRef CreateColumnFromAst(const TypeAst& ast, CreateColumnByTypeSetti
             }
         }
         case TypeAst::SimpleAggregateFunction: {
-            return CreateTerminalColumn(GetASTChildElement(ast, -1));
+            return CreateTerminalColumn(GetASTChildElement(ast, -1), settings);
         }
 
         case TypeAst::Map: {
@@ -265,12 +267,40 @@ static ColumnRef CreateColumnFromAst(const TypeAst& ast, CreateColumnByTypeSetti
 
 
 ColumnRef CreateColumnByType(const std::string& type_name, CreateColumnByTypeSettings settings) {
+    static constexpr size_t MaxPrototypesCount = 256;
+
+    // Empty columns of recently created types, cloning of which is cheaper than building from AST.
+    // Prototypes are never modified, so they share their types with all the clones.
+    thread_local std::unordered_map<std::string, ColumnRef> prototypes_by_storage[2];
+    auto& prototypes = prototypes_by_storage[settings.contiguous_strings];
+
+    // Adaptors of LowCardinality are not preserved by CloneEmpty().
+    if (settings.low_cardinality_as_wrapped_column) {
+        auto ast = ParseTypeName(type_name);
+        return ast ? CreateColumnFromAst(*ast, settings) : nullptr;
+    }
+
+    auto it = prototypes.find(type_name);
+    if (it != prototypes.end()) {
+        return it->second->CloneEmpty();
+    }
+
     auto ast = ParseTypeName(type_name);
-    if (ast != nullptr) {
-        return CreateColumnFromAst(*ast, settings);
+    if (ast == nullptr) {
+        return nullptr;
     }
 
-    return nullptr;
+    auto prototype = CreateColumnFromAst(*ast, settings);
+    if (prototype == nullptr) {
+        return nullptr;
+    }
+
+    if (prototypes.size() >= MaxPrototypesCount) {
+        prototypes.clear();
+    }
+    prototypes.emplace(type_name, prototype);
+
+    return prototype->CloneEmpty();
 }
 
 }
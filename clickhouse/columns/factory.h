@@ -7,6 +7,8 @@ namespace clickhouse {
 struct CreateColumnByTypeSettings
 {
     bool low_cardinality_as_wrapped_column = false;
+    /// String columns are created with ColumnString::Storage::Contiguous.
+    bool contiguous_strings = false;
 };
 
 ColumnRef CreateColumnByType(const std::string& type_name, CreateColumnByTypeSettings settings = {});
@@ -71,6 +71,11 @@ bool ColumnGeo<NestedColumnType, type_code>::LoadBody(InputStream* input, size_t
     return data_->LoadBody(input, rows);
 }
 
+template <typename NestedColumnType, Type::Code type_code>
+bool ColumnGeo<NestedColumnType, type_code>::SkipBody(InputStream* input, size_t rows) {
+    return data_->SkipBody(input, rows);
+}
+
 template <typename NestedColumnType, Type::Code type_code>
 void ColumnGeo<NestedColumnType, type_code>::SaveBody(OutputStream* output) {
     data_->SaveBody(output);
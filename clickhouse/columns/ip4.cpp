@@ -88,6 +88,10 @@ bool ColumnIPv4::LoadBody(InputStream * input, size_t rows) {
     return data_->LoadBody(input, rows);
 }
 
+bool ColumnIPv4::SkipBody(InputStream* input, size_t rows) {
+    return data_->SkipBody(input, rows);
+}
+
 void ColumnIPv4::SaveBody(OutputStream* output) {
     data_->SaveBody(output);
 }
@@ -48,6 +48,9 @@ public:
     /// Loads column data from input stream.
     bool LoadBody(InputStream* input, size_t rows) override;
 
+    /// Skips column data in input stream.
+    bool SkipBody(InputStream* input, size_t rows) override;
+
     /// Saves column data to output stream.
     void SaveBody(OutputStream* output) override;
 
@@ -79,6 +79,10 @@ bool ColumnIPv6::LoadBody(InputStream* input, size_t rows) {
     return data_->LoadBody(input, rows);
 }
 
+bool ColumnIPv6::SkipBody(InputStream* input, size_t rows) {
+    return data_->SkipBody(input, rows);
+}
+
 void ColumnIPv6::SaveBody(OutputStream* output) {
     data_->SaveBody(output);
 }
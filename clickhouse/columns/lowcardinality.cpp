@@ -340,6 +340,41 @@ bool ColumnLowCardinality::LoadBody(InputStream* input, size_t rows) {
     }
 }
 
+bool ColumnLowCardinality::SkipBody(InputStream* input, size_t rows) {
+    uint64_t index_serialization_type;
+    if (!WireFormat::ReadFixed(*input, &index_serialization_type)) {
+        return false;
+    }
+    if ((index_serialization_type & IndexFlag::NeedGlobalDictionaryBit)
+        || (index_serialization_type & IndexFlag::HasAdditionalKeysBit) == 0) {
+        return false;
+    }
+
+    uint64_t number_of_keys;
+    if (!WireFormat::ReadFixed(*input, &number_of_keys)) {
+        return false;
+    }
+
+    auto dictionary = dictionary_column_->CloneEmpty();
+    if (auto nullable = dictionary->As<ColumnNullable>()) {
+        dictionary = nullable->Nested();
+    }
+    if (!dictionary->SkipBody(input, number_of_keys)) {
+        return false;
+    }
+
+    uint64_t number_of_rows;
+    if (!WireFormat::ReadFixed(*input, &number_of_rows) || number_of_rows != rows) {
+        return false;
+    }
+
+    try {
+        return createIndexColumn(static_cast<IndexType>(index_serialization_type & IndexTypeMask))->SkipBody(input, number_of_rows);
+    } catch (...) {
+        return false;
+    }
+}
+
 void ColumnLowCardinality::SavePrefix(OutputStream* output) {
     const auto version = static_cast<uint64_t>(KeySerializationVersion::SharedDictionariesWithAdditionalKeys);
     WireFormat::WriteFixed(*output, version);
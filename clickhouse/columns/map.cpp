@@ -55,6 +55,10 @@ bool ColumnMap::LoadBody(InputStream* input, size_t rows) {
     return data_->LoadBody(input, rows);
 }
 
+bool ColumnMap::SkipBody(InputStream* input, size_t rows) {
+    return data_->SkipBody(input, rows);
+}
+
 void ColumnMap::SavePrefix(OutputStream* output) {
     data_->SavePrefix(output);
 }
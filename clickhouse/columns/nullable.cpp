@@ -1,5 +1,7 @@
 #include "nullable.h"
 
+#include "../base/input.h"
+
 #include <assert.h>
 #include <stdexcept>
 
@@ -69,6 +71,13 @@ bool ColumnNullable::LoadBody(InputStream* input, size_t rows) {
     return true;
 }
 
+bool ColumnNullable::SkipBody(InputStream* input, size_t rows) {
+    if (!input->Skip(rows)) {
+        return false;
+    }
+    return nested_->SkipBody(input, rows);
+}
+
 void ColumnNullable::SavePrefix(OutputStream* output) {
     nested_->SavePrefix(output);
 }
@@ -1,6 +1,7 @@
 #include "numeric.h"
 #include "utils.h"
 
+#include "../base/input.h"
 #include "../base/wire_format.h"
 
 namespace clickhouse {
@@ -77,6 +78,11 @@ bool ColumnVector<T>::LoadBody(InputStream* input, size_t rows) {
     return WireFormat::ReadBytes(*input, data_.data(), data_.size() * sizeof(T));
 }
 
+template <typename T>
+bool ColumnVector<T>::SkipBody(InputStream* input, size_t rows) {
+    return input->Skip(rows * sizeof(T));
+}
+
 template <typename T>
 void ColumnVector<T>::SaveBody(OutputStream* output) {
     WireFormat::WriteBytes(*output, data_.data(), data_.size() * sizeof(T));
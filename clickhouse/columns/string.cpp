@@ -1,11 +1,25 @@
 #include "string.h"
 #include "utils.h"
 
+#include "../base/input.h"
+#include "../base/output.h"
+#include "../base/varint.h"
 #include "../base/wire_format.h"
+#include "../exceptions.h"
 
 namespace {
 
 constexpr size_t DEFAULT_BLOCK_SIZE = 4096;
+/// Total capacity of emptied blocks kept by ColumnString::Clear(), the rest is freed.
+constexpr size_t MAX_FREE_BLOCKS_SIZE = 4 << 20;
+/// Number of contiguous values passed to the string kernels at once.
+constexpr size_t CONTIGUOUS_BATCH_SIZE = 256;
+
+template <typename Buffer>
+void AppendChars(Buffer& buffer, const char* chars, size_t len) {
+    const auto data = reinterpret_cast<const uint8_t*>(chars);
+    buffer.insert(buffer.end(), data, data + len);
+}
 
 template <typename Container>
 size_t ComputeTotalSize(const Container & strings, size_t begin = 0, size_t len = -1) {
@@ -85,6 +99,10 @@ bool ColumnFixedString::LoadBody(InputStream * input, size_t rows) {
     return true;
 }
 
+bool ColumnFixedString::SkipBody(InputStream* input, size_t rows) {
+    return input->Skip(string_size_ * rows);
+}
+
 void ColumnFixedString::SaveBody(OutputStream* output) {
     WireFormat::WriteBytes(*output, data_.data(), data_.size());
 }
@@ -153,7 +171,7 @@ struct ColumnString::Block
     }
 
     size_t size;
-    const size_t capacity;
+    size_t capacity;
     std::unique_ptr<CharT[]> data_;
 };
 
@@ -162,6 +180,12 @@ ColumnString::ColumnString()
 {
 }
 
+ColumnString::ColumnString(Storage storage)
+    : Column(Type::CreateString())
+    , storage_(storage)
+{
+}
+
 ColumnString::ColumnString(size_t element_count)
     : Column(Type::CreateString())
 {
@@ -197,14 +221,25 @@ ColumnString::~ColumnString()
 {}
 
 void ColumnString::Reserve(size_t new_cap) {
+    if (storage_ == Storage::Contiguous) {
+        offsets_.reserve(new_cap);
+        return;
+    }
+
     items_.reserve(new_cap);
     // 16 is arbitrary number, assumption that string values are about ~256 bytes long.
     blocks_.reserve(std::max<size_t>(1, new_cap / 16));
 }
 
 void ColumnString::Append(std::string_view str) {
+    if (storage_ == Storage::Contiguous) {
+        AppendChars(chars_, str.data(), str.size());
+        offsets_.push_back(chars_.size());
+        return;
+    }
+
     if (blocks_.size() == 0 || blocks_.back().GetAvailable() < str.length()) {
-        blocks_.emplace_back(std::max(DEFAULT_BLOCK_SIZE, str.size()));
+        NewBlock(str.size());
     }
 
     items_.emplace_back(blocks_.back().AppendUnsafe(str));
@@ -215,36 +250,151 @@ void ColumnString::Append(const char* str) {
 }
 
 void ColumnString::Append(std::string&& steal_value) {
+    if (storage_ == Storage::Contiguous) {
+        Append(std::string_view(steal_value));
+        return;
+    }
+
     append_data_.emplace_back(std::move(steal_value));
     auto& last_data = append_data_.back();
     items_.emplace_back(std::string_view{ last_data.data(),last_data.length() });
 }
 
 void ColumnString::AppendNoManagedLifetime(std::string_view str) {
+    if (storage_ == Storage::Contiguous) {
+        Append(str);
+        return;
+    }
+
     items_.emplace_back(str);
 }
 
+void ColumnString::AppendContiguous(const char* chars, const uint64_t* offsets, size_t count) {
+    AppendRange(chars, offsets, count, 0);
+}
+
+void ColumnString::AppendRange(const char* chars, const uint64_t* offsets, size_t count, uint64_t start) {
+    if (count == 0) {
+        return;
+    }
+
+    if (storage_ == Storage::Contiguous) {
+        const uint64_t base = chars_.size();
+        AppendChars(chars_, chars + start, offsets[count - 1] - start);
+
+        offsets_.reserve(offsets_.size() + count);
+        for (size_t i = 0; i < count; ++i) {
+            offsets_.push_back(base + offsets[i] - start);
+        }
+        return;
+    }
+
+    const size_t total_size = offsets[count - 1] - start;
+    if (blocks_.size() == 0 || blocks_.back().GetAvailable() < total_size)
+        NewBlock(total_size);
+
+    for (size_t i = 0; i < count; ++i) {
+        AppendUnsafe(std::string_view(chars + start, offsets[i] - start));
+        start = offsets[i];
+    }
+}
+
+std::string_view ColumnString::Chars() const {
+    if (storage_ != Storage::Contiguous) {
+        throw ValidationError("characters of ColumnString are not contiguous");
+    }
+    return std::string_view(reinterpret_cast<const char*>(chars_.data()), chars_.size());
+}
+
+const std::vector<uint64_t>& ColumnString::Offsets() const {
+    if (storage_ != Storage::Contiguous) {
+        throw ValidationError("characters of ColumnString are not contiguous");
+    }
+    return offsets_;
+}
+
 void ColumnString::AppendUnsafe(std::string_view str) {
     items_.emplace_back(blocks_.back().AppendUnsafe(str));
 }
 
+ColumnString::Block& ColumnString::NewBlock(size_t min_capacity) {
+    // The smallest free block which fits, larger ones are left for larger strings.
+    auto best = free_blocks_.end();
+    for (auto it = free_blocks_.begin(); it != free_blocks_.end(); ++it) {
+        if (it->capacity >= min_capacity && (best == free_blocks_.end() || it->capacity < best->capacity)) {
+            best = it;
+        }
+    }
+
+    if (best != free_blocks_.end()) {
+        blocks_.push_back(std::move(*best));
+        *best = std::move(free_blocks_.back());
+        free_blocks_.pop_back();
+    } else {
+        blocks_.emplace_back(std::max(DEFAULT_BLOCK_SIZE, min_capacity));
+    }
+
+    return blocks_.back();
+}
+
 void ColumnString::Clear() {
+    chars_.clear();
+    offsets_.clear();
+
     items_.clear();
-    blocks_.clear();
     append_data_.clear();
+    shared_buffers_.clear();
+
+    size_t free_size = 0;
+    for (const auto& block : free_blocks_) {
+        free_size += block.capacity;
+    }
+    for (auto& block : blocks_) {
+        if (free_size + block.capacity > MAX_FREE_BLOCKS_SIZE) {
+            continue;
+        }
+        free_size += block.capacity;
+        block.size = 0;
+        free_blocks_.push_back(std::move(block));
+    }
+    blocks_.clear();
 }
 
 std::string_view ColumnString::At(size_t n) const {
+    if (storage_ == Storage::Contiguous) {
+        if (n >= offsets_.size()) {
+            throw std::out_of_range("ColumnString::At: index " + std::to_string(n) + " is out of range");
+        }
+        return ContiguousAt(n);
+    }
+
     return items_.at(n);
 }
 
 void ColumnString::Append(ColumnRef column) {
     if (auto col = column->As<ColumnString>()) {
+        if (col->storage_ == Storage::Contiguous) {
+            if (col.get() == this) {
+                // Buffers of the column are appended to, so they are copied first.
+                Append(col->Slice(0, col->Size()));
+                return;
+            }
+            AppendRange(reinterpret_cast<const char*>(col->chars_.data()), col->offsets_.data(), col->offsets_.size(), 0);
+            return;
+        }
+        if (storage_ == Storage::Contiguous) {
+            chars_.reserve(chars_.size() + ComputeTotalSize(col->items_));
+            for (const auto& item : col->items_) {
+                Append(item);
+            }
+            return;
+        }
+
         const auto total_size = ComputeTotalSize(col->items_);
 
         // TODO: fill up existing block with some items and then add a new one for the rest of items
         if (blocks_.size() == 0 || blocks_.back().GetAvailable() < total_size)
-            blocks_.emplace_back(std::max(DEFAULT_BLOCK_SIZE, total_size));
+            NewBlock(total_size);
 
         // Intentionally not doing items_.reserve() since that cripples performance.
         for (size_t i = 0; i < column->Size(); ++i) {
@@ -254,53 +404,251 @@ void ColumnString::Append(ColumnRef column) {
 }
 
 bool ColumnString::LoadBody(InputStream* input, size_t rows) {
+    // Memory of the current data is reused for the loaded one.
+    Clear();
+
     if (rows == 0) {
-        items_.clear();
-        blocks_.clear();
+        return true;
+    }
+
+    if (storage_ == Storage::Contiguous) {
+        return LoadContiguous(input, rows);
+    }
+
+    items_.reserve(rows);
+
+    auto zero_copy_input = dynamic_cast<ZeroCopyInput*>(input);
+    if (!zero_copy_input) {
+        Block * block = nullptr;
+
+        for (size_t i = 0; i < rows; ++i) {
+            uint64_t len;
+            if (!WireFormat::ReadUInt64(*input, &len))
+                return false;
+
+            if (!block || len > block->GetAvailable())
+                block = &NewBlock(len);
+
+            if (!WireFormat::ReadBytes(*input, block->GetCurrentWritePos(), len))
+                return false;
+
+            items_.emplace_back(block->ConsumeTailAsStringViewUnsafe(len));
+        }
 
         return true;
     }
 
-    decltype(items_) new_items;
-    decltype(blocks_) new_blocks;
+    // Strings are decoded by runs right in the buffer of the stream.
+    WireReader reader(*zero_copy_input);
+    // If the stream can share its buffers, strings are referenced right in them.
+    bool share_buffers = true;
+    Block * block = nullptr;
 
-    new_items.reserve(rows);
+    items_.resize(rows);
 
-    // Suboptimzal if the first row string is >DEFAULT_BLOCK_SIZE, but that must be a very rare case.
-    Block * block = &new_blocks.emplace_back(DEFAULT_BLOCK_SIZE);
+    for (size_t i = 0; i < rows; ) {
+        const void* data = nullptr;
+        const size_t avail = reader.Peek(&data);
 
-    for (size_t i = 0; i < rows; ++i) {
+        // Stream has a buffer for sure once something is read from it.
+        if (i == 0 && !reader.GetBufferOwner()) {
+            share_buffers = false;
+        }
+
+        size_t decoded = 0;
+        reader.Advance(DecodeStrings(static_cast<const uint8_t*>(data), avail, items_.data() + i, rows - i, &decoded));
+
+        if (share_buffers) {
+            const auto& owner = reader.GetBufferOwner();
+            if (decoded && (shared_buffers_.empty() || shared_buffers_.back() != owner)) {
+                shared_buffers_.push_back(owner);
+            }
+        } else {
+            for (size_t j = i; j < i + decoded; ++j) {
+                const size_t len = items_[j].size();
+                if (!block || len > block->GetAvailable())
+                    block = &NewBlock(len);
+
+                memcpy(block->GetCurrentWritePos(), items_[j].data(), len);
+                items_[j] = block->ConsumeTailAsStringViewUnsafe(len);
+            }
+        }
+        i += decoded;
+
+        if (i == rows) {
+            break;
+        }
+
+        // The string continues in the next buffer, so it is copied.
         uint64_t len;
-        if (!WireFormat::ReadUInt64(*input, &len))
+        if (!reader.ReadUInt64(&len)) {
+            items_.resize(i);
             return false;
+        }
 
-        if (len > block->GetAvailable())
-            block = &new_blocks.emplace_back(std::max<size_t>(DEFAULT_BLOCK_SIZE, len));
+        if (!block || len > block->GetAvailable())
+            block = &NewBlock(len);
 
-        if (!WireFormat::ReadBytes(*input, block->GetCurrentWritePos(), len))
+        if (!reader.ReadBytes(block->GetCurrentWritePos(), len)) {
+            items_.resize(i);
             return false;
+        }
 
-        new_items.emplace_back(block->ConsumeTailAsStringViewUnsafe(len));
+        items_[i++] = block->ConsumeTailAsStringViewUnsafe(len);
     }
 
-    items_.swap(new_items);
-    blocks_.swap(new_blocks);
+    return true;
+}
+
+bool ColumnString::LoadContiguous(InputStream* input, size_t rows) {
+    offsets_.reserve(rows);
+
+    // Reads the next value through the stream, returns false if it's failed.
+    const auto load_value = [this] (auto&& read_length, auto&& read_bytes) {
+        uint64_t len;
+        if (!read_length(&len))
+            return false;
+
+        const size_t pos = chars_.size();
+        chars_.resize(pos + len);
+        if (!read_bytes(chars_.data() + pos, len)) {
+            chars_.resize(pos);
+            return false;
+        }
+
+        offsets_.push_back(chars_.size());
+        return true;
+    };
+
+    auto zero_copy_input = dynamic_cast<ZeroCopyInput*>(input);
+    if (!zero_copy_input) {
+        for (size_t i = 0; i < rows; ++i) {
+            const bool loaded = load_value(
+                [input] (uint64_t* len) { return WireFormat::ReadUInt64(*input, len); },
+                [input] (void* buf, size_t len) { return WireFormat::ReadBytes(*input, buf, len); });
+            if (!loaded)
+                return false;
+        }
+
+        return true;
+    }
+
+    // Values are decoded by runs right in the buffer of the stream and copied one after another.
+    WireReader reader(*zero_copy_input);
+    std::string_view batch[CONTIGUOUS_BATCH_SIZE];
+
+    for (size_t i = 0; i < rows; ) {
+        const void* data = nullptr;
+        const size_t avail = reader.Peek(&data);
+
+        size_t decoded = 0;
+        reader.Advance(DecodeStrings(static_cast<const uint8_t*>(data), avail, batch,
+                std::min(rows - i, CONTIGUOUS_BATCH_SIZE), &decoded));
+
+        for (size_t j = 0; j < decoded; ++j) {
+            AppendChars(chars_, batch[j].data(), batch[j].size());
+            offsets_.push_back(chars_.size());
+        }
+        i += decoded;
+
+        if (i == rows || decoded == CONTIGUOUS_BATCH_SIZE) {
+            continue;
+        }
+
+        // The value continues in the next buffer.
+        const bool loaded = load_value(
+            [&reader] (uint64_t* len) { return reader.ReadUInt64(len); },
+            [&reader] (void* buf, size_t len) { return reader.ReadBytes(buf, len); });
+        if (!loaded)
+            return false;
+        ++i;
+    }
+
+    return true;
+}
+
+bool ColumnString::SkipBody(InputStream* input, size_t rows) {
+    for (size_t i = 0; i < rows; ++i) {
+        if (!WireFormat::SkipString(*input)) {
+            return false;
+        }
+    }
 
     return true;
 }
 
+/// Encodes strings by runs right into the buffer of the stream.
+static void WriteStrings(WireWriter& writer, const std::string_view* items, size_t count) {
+    for (size_t i = 0; i < count; ) {
+        void* data = nullptr;
+        const size_t avail = writer.Peek(&data);
+
+        size_t encoded = 0;
+        writer.Advance(EncodeStrings(items + i, count - i, static_cast<uint8_t*>(data), avail, &encoded));
+        i += encoded;
+
+        // The string doesn't fit into the rest of the buffer.
+        if (i < count) {
+            writer.WriteString(items[i++]);
+        }
+    }
+}
+
 void ColumnString::SaveBody(OutputStream* output) {
+    if (storage_ == Storage::Contiguous) {
+        SaveContiguous(output);
+        return;
+    }
+
+    if (auto zero_copy_output = dynamic_cast<ZeroCopyOutput*>(output)) {
+        WireWriter writer(*zero_copy_output);
+        WriteStrings(writer, items_.data(), items_.size());
+        return;
+    }
+
     for (const auto & item : items_) {
         WireFormat::WriteString(*output, item);
     }
 }
 
+void ColumnString::SaveContiguous(OutputStream* output) {
+    auto zero_copy_output = dynamic_cast<ZeroCopyOutput*>(output);
+    if (!zero_copy_output) {
+        for (size_t i = 0; i < offsets_.size(); ++i) {
+            WireFormat::WriteString(*output, ContiguousAt(i));
+        }
+        return;
+    }
+
+    WireWriter writer(*zero_copy_output);
+    std::string_view batch[CONTIGUOUS_BATCH_SIZE];
+
+    for (size_t i = 0; i < offsets_.size(); ) {
+        const size_t count = std::min(offsets_.size() - i, CONTIGUOUS_BATCH_SIZE);
+        for (size_t j = 0; j < count; ++j) {
+            batch[j] = ContiguousAt(i + j);
+        }
+
+        WriteStrings(writer, batch, count);
+        i += count;
+    }
+}
+
 size_t ColumnString::Size() const {
-    return items_.size();
+    return (storage_ == Storage::Contiguous) ? offsets_.size() : items_.size();
 }
 
 ColumnRef ColumnString::Slice(size_t begin, size_t len) const {
-    auto result = std::make_shared<ColumnString>();
+    auto result = std::make_shared<ColumnString>(storage_);
+
+    if (storage_ == Storage::Contiguous) {
+        if (begin < offsets_.size()) {
+            len = std::min(len, offsets_.size() - begin);
+            result->AppendRange(reinterpret_cast<const char*>(chars_.data()), offsets_.data() + begin, len,
+                    begin ? offsets_[begin - 1] : 0);
+        }
+        return result;
+    }
 
     if (begin < items_.size()) {
         len = std::min(len, items_.size() - begin);
@@ -316,14 +664,18 @@ ColumnRef ColumnString::Slice(size_t begin, size_t len) const {
 }
 
 ColumnRef ColumnString::CloneEmpty() const {
-    return std::make_shared<ColumnString>();
+    return std::make_shared<ColumnString>(storage_);
 }
 
 void ColumnString::Swap(Column& other) {
     auto & col = dynamic_cast<ColumnString &>(other);
+    std::swap(storage_, col.storage_);
+    chars_.swap(col.chars_);
+    offsets_.swap(col.offsets_);
     items_.swap(col.items_);
     blocks_.swap(col.blocks_);
     append_data_.swap(col.append_data_);
+    shared_buffers_.swap(col.shared_buffers_);
 }
 
 ItemView ColumnString::GetItem(size_t index) const {
@@ -1,12 +1,14 @@
 #pragma once
 
 #include "column.h"
+#include "../base/buffer.h"
 
 #include <string>
 #include <string_view>
 #include <utility>
 #include <vector>
 #include <deque>
+#include <memory>
 
 namespace clickhouse {
 
@@ -49,6 +51,9 @@ public:
     /// Loads column data from input stream.
     bool LoadBody(InputStream* input, size_t rows) override;
 
+    /// Skips column data in input stream.
+    bool SkipBody(InputStream* input, size_t rows) override;
+
     /// Saves column data to output stream.
     void SaveBody(OutputStream* output) override;
 
@@ -78,9 +83,19 @@ public:
     // Type this column takes as argument of Append and returns with At() and operator[]
     using ValueType = std::string_view;
 
+    /// Layout of the values in memory.
+    enum class Storage {
+        /// View of each value, which points into blocks of the column, moved in strings or buffers of the input stream.
+        Views,
+        /// All values one after another in a single buffer and offsets of their ends in it, like ClickHouse keeps them.
+        /// Takes 8 bytes per value besides the characters, and both buffers may be used without copying.
+        Contiguous,
+    };
+
     ColumnString();
     ~ColumnString();
 
+    explicit ColumnString(Storage storage);
     explicit ColumnString(size_t element_count);
     explicit ColumnString(const std::vector<std::string> & data);
     explicit ColumnString(std::vector<std::string>&& data);
@@ -109,6 +124,19 @@ public:
     /// Returns element at given row number.
     inline std::string_view operator [] (size_t n) const { return At(n); }
 
+    Storage GetStorage() const {
+        return storage_;
+    }
+
+    /// Appends \p count elements, which lie one after another in \p chars and end at \p offsets in it.
+    void AppendContiguous(const char* chars, const uint64_t* offsets, size_t count);
+
+    /// Characters of all the elements, for Storage::Contiguous only.
+    std::string_view Chars() const;
+
+    /// Offsets of ends of the elements in Chars(), for Storage::Contiguous only.
+    const std::vector<uint64_t>& Offsets() const;
+
 public:
     /// Appends content of given column to the end of current one.
     void Append(ColumnRef column) override;
@@ -116,6 +144,9 @@ public:
     /// Loads column data from input stream.
     bool LoadBody(InputStream* input, size_t rows) override;
 
+    /// Skips column data in input stream.
+    bool SkipBody(InputStream* input, size_t rows) override;
+
     /// Saves column data to output stream.
     void SaveBody(OutputStream* output) override;
 
@@ -134,11 +165,34 @@ public:
 private:
     void AppendUnsafe(std::string_view);
 
-private:
+    /// Appends elements from \p chars, the first one starts at \p start.
+    void AppendRange(const char* chars, const uint64_t* offsets, size_t count, uint64_t start);
+
+    bool LoadContiguous(InputStream* input, size_t rows);
+    void SaveContiguous(OutputStream* output);
+
+    inline std::string_view ContiguousAt(size_t n) const {
+        const uint64_t start = n ? offsets_[n - 1] : 0;
+        return std::string_view(reinterpret_cast<const char*>(chars_.data()) + start, offsets_[n] - start);
+    }
+
     struct Block;
 
+    /// Appends block which fits at least \p min_capacity bytes, reusing a block released by Clear() if possible.
+    Block& NewBlock(size_t min_capacity);
+
+private:
+    Storage storage_ = Storage::Views;
+    /// Data of Storage::Contiguous.
+    UninitializedBuffer chars_;
+    std::vector<uint64_t> offsets_;
+
     std::vector<std::string_view> items_;
     std::vector<Block> blocks_;
+    /// Emptied blocks, which are kept by Clear() for the data loaded or appended next, up to a limit of their total size.
+    std::vector<Block> free_blocks_;
+    /// Buffers of the input stream, which items loaded without copying point to.
+    std::vector<std::shared_ptr<const void>> shared_buffers_;
     std::deque<std::string> append_data_;
 };
 
@@ -82,6 +82,16 @@ bool ColumnTuple::LoadBody(InputStream* input, size_t rows) {
     return true;
 }
 
+bool ColumnTuple::SkipBody(InputStream* input, size_t rows) {
+    for (auto ci = columns_.begin(); ci != columns_.end(); ++ci) {
+        if (!(*ci)->SkipBody(input, rows)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 void ColumnTuple::SavePrefix(OutputStream* output) {
     for (auto & column : columns_) {
         column->SavePrefix(output);
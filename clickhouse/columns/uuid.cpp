@@ -48,6 +48,10 @@ bool ColumnUUID::LoadBody(InputStream* input, size_t rows) {
     return data_->LoadBody(input, rows * 2);
 }
 
+bool ColumnUUID::SkipBody(InputStream* input, size_t rows) {
+    return data_->SkipBody(input, rows * 2);
+}
+
 void ColumnUUID::SaveBody(OutputStream* output) {
     data_->SaveBody(output);
 }
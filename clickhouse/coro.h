@@ -0,0 +1,229 @@
+#pragma once
+
+#include "async_client.h"
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+
+/**
+ * Awaitable wrappers of AsyncClient for C++20 coroutines, available when the code
+ * including this header is compiled with coroutines support.
+ *
+ *     Task<void> Run(AsyncClient& client) {
+ *         co_await coro::Execute(client, Query("CREATE TABLE ..."));
+ *
+ *         auto stream = coro::Select(client, "SELECT ...");
+ *         while (auto block = co_await stream.Next()) {
+ *             ...
+ *         }
+ *     }
+ *
+ * Coroutine is suspended until the query is finished or the next block is received,
+ * so no thread is blocked while waiting for the server.
+ */
+namespace clickhouse::coro {
+
+/// Resumes suspended coroutine. If not set, coroutine is resumed on the loop thread of the client.
+using Executor = std::function<void(std::coroutine_handle<>)>;
+
+namespace detail {
+
+inline void Resume(const Executor& executor, std::coroutine_handle<> handle) {
+    if (executor) {
+        executor(handle);
+    } else {
+        handle.resume();
+    }
+}
+
+/// Starts an operation of AsyncClient on suspension and resumes the coroutine on its completion.
+class CompletionAwaitable {
+public:
+    using Start = std::function<void(AsyncClient::CompletionCallback)>;
+
+    CompletionAwaitable(Start start, Executor executor)
+        : start_(std::move(start))
+        , executor_(std::move(executor))
+    {
+    }
+
+    bool await_ready() const noexcept {
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle) {
+        // Awaitable may be destroyed as soon as the operation is completed,
+        // so it must not be accessed after the operation is started.
+        auto start = std::move(start_);
+        start([this, handle] (std::exception_ptr error) {
+            error_ = std::move(error);
+            Resume(executor_, handle);
+        });
+    }
+
+    void await_resume() {
+        if (error_) {
+            std::rethrow_exception(error_);
+        }
+    }
+
+private:
+    Start start_;
+    Executor executor_;
+    std::exception_ptr error_;
+};
+
+}
+
+/// Executes arbitrary query, throws an exception on failure when awaited.
+inline detail::CompletionAwaitable Execute(AsyncClient& client, Query query, Executor executor = {}) {
+    return detail::CompletionAwaitable(
+        [&client, query = std::move(query)] (AsyncClient::CompletionCallback cb) mutable {
+            client.Execute(std::move(query), std::move(cb));
+        },
+        std::move(executor));
+}
+
+/// Inserts block of data into a table, block must not be modified until the coroutine is resumed.
+inline detail::CompletionAwaitable Insert(AsyncClient& client, std::string table_name, Block block, Executor executor = {}) {
+    return detail::CompletionAwaitable(
+        [&client, table_name = std::move(table_name), block = std::move(block)] (AsyncClient::CompletionCallback cb) {
+            client.Insert(table_name, block, std::move(cb));
+        },
+        std::move(executor));
+}
+
+/**
+ * Blocks of a select query in order of their arrival, blocks are the same which
+ * SelectCallback receives, including the header one.
+ *
+ * Received blocks are kept until consumed. Destroying the stream before the end of
+ * data cancels the query.
+ *
+ * The queue of received blocks isn't bounded: blocks are pushed by the loop thread,
+ * which serves other connections as well and must never wait for a consumer. So a
+ * consumer falling behind may accumulate the whole result, just like a SelectCallback
+ * keeping the blocks would. Results which don't fit into memory should be limited by
+ * the query or read by Client::SelectCursor(), which receives a bounded number of blocks ahead.
+ */
+class BlockStream {
+    struct State {
+        std::mutex mutex;
+        std::deque<Block> blocks;
+        bool finished = false;
+        bool cancelled = false;
+        std::exception_ptr error;
+        std::coroutine_handle<> waiter;
+        Executor executor;
+
+        /// Must be called with the mutex locked, unlocks it before resuming the waiter.
+        void Wakeup(std::unique_lock<std::mutex>& lock) {
+            auto handle = std::exchange(waiter, nullptr);
+            lock.unlock();
+            if (handle) {
+                detail::Resume(executor, handle);
+            }
+        }
+    };
+
+public:
+    class NextAwaitable {
+    public:
+        explicit NextAwaitable(State& state)
+            : state_(state)
+        {
+        }
+
+        bool await_ready() const {
+            std::lock_guard<std::mutex> lock(state_.mutex);
+            return !state_.blocks.empty() || state_.finished;
+        }
+
+        bool await_suspend(std::coroutine_handle<> handle) {
+            std::lock_guard<std::mutex> lock(state_.mutex);
+            if (!state_.blocks.empty() || state_.finished) {
+                return false;
+            }
+            state_.waiter = handle;
+            return true;
+        }
+
+        /// Returns next block or nothing at the end of data, throws an exception if query has failed.
+        std::optional<Block> await_resume() {
+            std::lock_guard<std::mutex> lock(state_.mutex);
+            if (!state_.blocks.empty()) {
+                std::optional<Block> block(std::move(state_.blocks.front()));
+                state_.blocks.pop_front();
+                return block;
+            }
+            if (state_.error) {
+                std::rethrow_exception(state_.error);
+            }
+            return std::nullopt;
+        }
+
+    private:
+        State& state_;
+    };
+
+    BlockStream(AsyncClient& client, const std::string& query, Executor executor)
+        : state_(std::make_shared<State>())
+    {
+        state_->executor = std::move(executor);
+
+        client.Execute(
+            Query(query).OnDataCancelable([state = state_] (const Block& block) {
+                std::unique_lock<std::mutex> lock(state->mutex);
+                if (state->cancelled) {
+                    return false;
+                }
+                state->blocks.push_back(block);
+                state->Wakeup(lock);
+                return true;
+            }),
+            [state = state_] (std::exception_ptr error) {
+                std::unique_lock<std::mutex> lock(state->mutex);
+                state->finished = true;
+                if (!state->cancelled) {
+                    state->error = std::move(error);
+                }
+                state->Wakeup(lock);
+            });
+    }
+
+    // Stream is never left without the state, Select() returns it without a move.
+    BlockStream(const BlockStream&) = delete;
+    BlockStream& operator=(const BlockStream&) = delete;
+
+    ~BlockStream() {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        state_->cancelled = true;
+        state_->blocks.clear();
+    }
+
+    /// Must not be awaited concurrently.
+    NextAwaitable Next() {
+        return NextAwaitable(*state_);
+    }
+
+private:
+    std::shared_ptr<State> state_;
+};
+
+/// Starts select query, blocks are read with co_await stream.Next().
+inline BlockStream Select(AsyncClient& client, const std::string& query, Executor executor = {}) {
+    return BlockStream(client, query, std::move(executor));
+}
+
+}
+
+#endif
@@ -11,6 +11,7 @@
 #include <optional>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 
 namespace clickhouse {
 
@@ -139,6 +140,19 @@ public:
         return *this;
     }
 
+    inline const std::unordered_set<std::string>& GetColumnProjection() const {
+        return column_projection_;
+    }
+
+    /** Limits columns of the result to the given names. Data of other columns is skipped
+     *  while being received without decoding, and the columns are absent in the received blocks.
+     *  Empty set means all columns.
+     */
+    inline Query& SetColumnProjection(std::unordered_set<std::string> columns) {
+        column_projection_ = std::move(columns);
+        return *this;
+    }
+
     /// Set handler for receiving result data.
     inline Query& OnData(SelectCallback cb) {
         select_cb_ = std::move(cb);
@@ -234,6 +248,7 @@ private:
     std::optional<open_telemetry::TracingContext> tracing_context_;
     QuerySettings query_settings_;
     QueryParams query_params_;
+    std::unordered_set<std::string> column_projection_;
     ExceptionCallback exception_cb_;
     ProgressCallback progress_cb_;
     SelectCallback select_cb_;
@@ -5,7 +5,7 @@
 
 #include <algorithm>
 #include <cmath>
-#include <map>
+#include <memory>
 #include <mutex>
 #include <unordered_map>
 
@@ -288,25 +288,70 @@ TypeParser::Token TypeParser::NextToken() {
 }
 
 
-const TypeAst* ParseTypeName(const std::string& type_name) {
-    // Cache for type_name.
-    // Usually we won't have too many type names in the cache, so do not try to
-    // limit cache size.
-    static std::map<std::string, TypeAst> ast_cache;
-    static std::mutex lock;
+namespace {
 
-    std::lock_guard<std::mutex> guard(lock);
-    auto it = ast_cache.find(type_name);
-    if (it != ast_cache.end()) {
-        return &it->second;
+/// Parsed types shared by all threads, split into shards locked independently.
+class TypeAstStore {
+public:
+    static constexpr size_t ShardsCount = 16;
+    static constexpr size_t MaxShardSize = 256;
+
+    std::shared_ptr<const TypeAst> Get(const std::string& type_name) {
+        auto& shard = shards_[std::hash<std::string>{}(type_name) % ShardsCount];
+
+        {
+            std::lock_guard<std::mutex> guard(shard.lock);
+            auto it = shard.asts.find(type_name);
+            if (it != shard.asts.end()) {
+                return it->second;
+            }
+        }
+
+        // Parse outside of the lock, concurrent parsing of the same name is harmless.
+        auto ast = std::make_shared<TypeAst>();
+        if (!TypeParser(type_name).Parse(ast.get())) {
+            return nullptr;
+        }
+
+        std::lock_guard<std::mutex> guard(shard.lock);
+        if (shard.asts.size() >= MaxShardSize) {
+            // ASTs are owned by callers too, so any of them may be evicted.
+            shard.asts.erase(shard.asts.begin());
+        }
+        return shard.asts.emplace(type_name, std::move(ast)).first->second;
     }
 
-    auto& ast = ast_cache[type_name];
-    if (TypeParser(type_name).Parse(&ast)) {
-        return &ast;
+private:
+    struct Shard {
+        std::mutex lock;
+        std::unordered_map<std::string, std::shared_ptr<const TypeAst>> asts;
+    };
+
+    Shard shards_[ShardsCount];
+};
+
+}
+
+std::shared_ptr<const TypeAst> ParseTypeName(const std::string& type_name) {
+    static constexpr size_t MaxLocalCacheSize = 64;
+
+    static TypeAstStore store;
+    // Types of consecutive blocks are usually the same, so they are found without any locking.
+    thread_local std::unordered_map<std::string, std::shared_ptr<const TypeAst>> local_cache;
+
+    auto it = local_cache.find(type_name);
+    if (it != local_cache.end()) {
+        return it->second;
+    }
+
+    auto ast = store.Get(type_name);
+    if (ast) {
+        if (local_cache.size() >= MaxLocalCacheSize) {
+            local_cache.clear();
+        }
+        local_cache.emplace(type_name, ast);
     }
-    ast_cache.erase(type_name);
-    return nullptr;
+    return ast;
 }
 
 }
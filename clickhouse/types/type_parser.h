@@ -4,6 +4,7 @@
 #include "types.h"
 
 #include <list>
+#include <memory>
 #include <stack>
 #include <string>
 
@@ -84,6 +85,8 @@ private:
 };
 
 
-const TypeAst* ParseTypeName(const std::string& type_name);
+/// Returns AST of the type name or null if the name can't be parsed.
+/// ASTs are cached, so names are parsed only once.
+std::shared_ptr<const TypeAst> ParseTypeName(const std::string& type_name);
 
 }
@@ -178,11 +178,13 @@ TypeRef Type::CreateArray(TypeRef item_type) {
 }
 
 TypeRef Type::CreateDate() {
-    return TypeRef(new Type(Type::Date));
+    static const TypeRef type(new Type(Type::Date));
+    return type;
 }
 
 TypeRef Type::CreateDate32() {
-    return TypeRef(new Type(Type::Date32));
+    static const TypeRef type(new Type(Type::Date32));
+    return type;
 }
 
 TypeRef Type::CreateDateTime(std::string timezone) {
@@ -198,15 +200,18 @@ TypeRef Type::CreateDecimal(size_t precision, size_t scale) {
 }
 
 TypeRef Type::CreateIPv4() {
-    return TypeRef(new Type(Type::IPv4));
+    static const TypeRef type(new Type(Type::IPv4));
+    return type;
 }
 
 TypeRef Type::CreateIPv6() {
-    return TypeRef(new Type(Type::IPv6));
+    static const TypeRef type(new Type(Type::IPv6));
+    return type;
 }
 
 TypeRef Type::CreateNothing() {
-    return TypeRef(new Type(Type::Void));
+    static const TypeRef type(new Type(Type::Void));
+    return type;
 }
 
 TypeRef Type::CreateNullable(TypeRef nested_type) {
@@ -214,7 +219,8 @@ TypeRef Type::CreateNullable(TypeRef nested_type) {
 }
 
 TypeRef Type::CreateString() {
-    return TypeRef(new Type(Type::String));
+    static const TypeRef type(new Type(Type::String));
+    return type;
 }
 
 TypeRef Type::CreateString(size_t n) {
@@ -234,7 +240,8 @@ TypeRef Type::CreateEnum16(const std::vector<EnumItem>& enum_items) {
 }
 
 TypeRef Type::CreateUUID() {
-    return TypeRef(new Type(Type::UUID));
+    static const TypeRef type(new Type(Type::UUID));
+    return type;
 }
 
 TypeRef Type::CreateLowCardinality(TypeRef item_type) {
@@ -246,19 +253,23 @@ TypeRef Type::CreateMap(TypeRef key_type, TypeRef value_type) {
 }
 
 TypeRef Type::CreatePoint() {
-    return TypeRef(new Type(Type::Point));
+    static const TypeRef type(new Type(Type::Point));
+    return type;
 }
 
 TypeRef Type::CreateRing() {
-    return TypeRef(new Type(Type::Ring));
+    static const TypeRef type(new Type(Type::Ring));
+    return type;
 }
 
 TypeRef Type::CreatePolygon() {
-    return TypeRef(new Type(Type::Polygon));
+    static const TypeRef type(new Type(Type::Polygon));
+    return type;
 }
 
 TypeRef Type::CreateMultiPolygon() {
-    return TypeRef(new Type(Type::MultiPolygon));
+    static const TypeRef type(new Type(Type::MultiPolygon));
+    return type;
 }
 
 /// class ArrayType
@@ -443,6 +443,54 @@ TYPED_TEST(GenericColumnTest, LoadAndSave) {
     EXPECT_TRUE(CompareRecursive(*column_A, *column_B));
 }
 
+TYPED_TEST(GenericColumnTest, SaveAndSkip) {
+    auto [column, values] = this->MakeColumnWithValues(100);
+
+    auto array = std::make_shared<ColumnArray>(column->CloneEmpty());
+    for (size_t i = 0; i < 10; ++i) {
+        array->AppendAsColumn(column->Slice(i * 10, i));
+    }
+
+    for (ColumnRef col : {ColumnRef(column), ColumnRef(array)}) {
+        SCOPED_TRACE(col->Type()->GetName());
+
+        Buffer buffer;
+        {
+            BufferOutput output(&buffer);
+            col->Save(&output);
+            output.Flush();
+        }
+        const size_t saved_size = buffer.size();
+        // Data of the next column must be left intact.
+        buffer.push_back(0xAB);
+
+        ArrayInput input(buffer.data(), buffer.size());
+        ASSERT_TRUE(col->CloneEmpty()->Skip(&input, col->Size()));
+        EXPECT_EQ(1u, input.Avail()) << "saved " << saved_size << " bytes";
+    }
+}
+
+TYPED_TEST(GenericColumnTest, LoadAfterClear) {
+    auto [column_A, values] = this->MakeColumnWithValues(100);
+
+    Buffer buffer;
+    {
+        BufferOutput output(&buffer);
+        column_A->Save(&output);
+        output.Flush();
+    }
+
+    // Column is loaded into the memory left by the previous data.
+    auto column_B = this->MakeColumn();
+    for (int i = 0; i < 2; ++i) {
+        column_B->Clear();
+
+        ArrayInput input(buffer.data(), buffer.size());
+        ASSERT_TRUE(column_B->Load(&input, values.size()));
+        EXPECT_TRUE(CompareRecursive(*column_A, *column_B));
+    }
+}
+
 const auto LocalHostEndpoint = ClientOptions()
         .SetHost(           getEnvOrDefault("CLICKHOUSE_HOST",     "localhost"))
         .SetPort(   getEnvOrDefault<size_t>("CLICKHOUSE_PORT",     "9000"))
@@ -5,6 +5,8 @@
 
 #include <gtest/gtest.h>
 
+#include <typeinfo>
+
 namespace {
 using namespace clickhouse;
 }
@@ -42,6 +44,18 @@ TEST(CreateColumnByType, LowCardinalityAsWrappedColumn) {
     ASSERT_EQ(Type::FixedString, CreateColumnByType("LowCardinality(FixedString(10000))", create_column_settings)->As<ColumnFixedString>()->GetType().GetCode());
 }
 
+TEST(CreateColumnByType, ContiguousStrings) {
+    CreateColumnByTypeSettings create_column_settings;
+    create_column_settings.contiguous_strings = true;
+
+    // Columns cached for one setting are not returned for the other one.
+    for (int i = 0; i < 2; ++i) {
+        EXPECT_EQ(ColumnString::Storage::Views, CreateColumnByType("String")->As<ColumnString>()->GetStorage());
+        EXPECT_EQ(ColumnString::Storage::Contiguous,
+                CreateColumnByType("String", create_column_settings)->As<ColumnString>()->GetStorage());
+    }
+}
+
 TEST(CreateColumnByType, DateTime) {
     ASSERT_NE(nullptr, CreateColumnByType("DateTime"));
     ASSERT_NE(nullptr, CreateColumnByType("DateTime('Europe/Moscow')"));
@@ -72,6 +86,21 @@ TEST_P(CreateColumnByTypeWithName, CreateColumnByType)
     EXPECT_EQ(col->GetType().GetName(), GetParam());
 }
 
+TEST_P(CreateColumnByTypeWithName, CreateColumnByTypeTwice)
+{
+    // Second column is cloned from the prototype cached by the first call.
+    const auto col1 = CreateColumnByType(GetParam());
+    const auto col2 = CreateColumnByType(GetParam());
+    ASSERT_NE(nullptr, col1);
+    ASSERT_NE(nullptr, col2);
+    EXPECT_NE(col1, col2);
+
+    const Column& c1 = *col1;
+    const Column& c2 = *col2;
+    EXPECT_EQ(typeid(c1), typeid(c2));
+    EXPECT_EQ(col2->GetType().GetName(), GetParam());
+}
+
 INSTANTIATE_TEST_SUITE_P(Basic, CreateColumnByTypeWithName, ::testing::Values(
     "Int8", "Int16", "Int32", "Int64",
     "UInt8", "UInt16", "UInt32", "UInt64",
@@ -0,0 +1,260 @@
+#include <clickhouse/async_client.h>
+
+#include "utils.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <future>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+using namespace clickhouse;
+
+namespace {
+
+const auto LocalHostEndpoint = ClientOptions()
+        .SetHost(           getEnvOrDefault("CLICKHOUSE_HOST",     "localhost"))
+        .SetPort(   getEnvOrDefault<size_t>("CLICKHOUSE_PORT",     "9000"))
+        .SetUser(           getEnvOrDefault("CLICKHOUSE_USER",     "default"))
+        .SetPassword(       getEnvOrDefault("CLICKHOUSE_PASSWORD", ""))
+        .SetDefaultDatabase(getEnvOrDefault("CLICKHOUSE_DB",       "default"));
+
+/// Runs the loop on a separate thread for the lifetime of the object.
+class LoopThread {
+public:
+    LoopThread()
+        : thread_([this] { loop_.Run(); })
+    {
+    }
+
+    ~LoopThread() {
+        loop_.Stop();
+        thread_.join();
+    }
+
+    EventLoop& Get() {
+        return loop_;
+    }
+
+private:
+    EventLoop loop_;
+    std::thread thread_;
+};
+
+}
+
+TEST(EventLoop, PostFromAnotherThread) {
+    EventLoop loop;
+    std::atomic<int> executed{0};
+
+    std::thread producer([&] {
+        for (int i = 0; i < 100; ++i) {
+            loop.Post([&] { ++executed; });
+        }
+        loop.Post([&] { loop.Stop(); });
+    });
+
+    loop.Run();
+    producer.join();
+
+    EXPECT_EQ(100, executed);
+}
+
+TEST(EventLoop, ScheduleOrder) {
+    EventLoop loop;
+    std::vector<int> order;
+
+    loop.Post([&] {
+        loop.Schedule(std::chrono::milliseconds(20), [&] { order.push_back(3); loop.Stop(); });
+        loop.Schedule(std::chrono::milliseconds(10), [&] { order.push_back(1); });
+        loop.Schedule(std::chrono::milliseconds(10), [&] { order.push_back(2); });
+        loop.Schedule(std::chrono::milliseconds(0),  [&] { order.push_back(0); });
+    });
+
+    const auto start = std::chrono::steady_clock::now();
+    loop.Run();
+
+    EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(20));
+    EXPECT_EQ((std::vector<int>{0, 1, 2, 3}), order);
+}
+
+TEST(EventLoop, WatchPipe) {
+    int fds[2];
+    ASSERT_EQ(0, pipe(fds));
+
+    EventLoop loop;
+    std::string received;
+
+    loop.Post([&] {
+        loop.Watch(fds[0], EventLoop::Readable, [&] (uint32_t events) {
+            EXPECT_TRUE(events & EventLoop::Readable);
+
+            char buf[16];
+            const auto ret = read(fds[0], buf, sizeof(buf));
+            if (ret > 0) {
+                received.append(buf, static_cast<size_t>(ret));
+            }
+            if (received.size() == 5) {
+                loop.Unwatch(fds[0]);
+                loop.Stop();
+            }
+        });
+    });
+
+    std::thread writer([&] {
+        for (const char* part : {"he", "llo"}) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            EXPECT_EQ(static_cast<ssize_t>(strlen(part)), write(fds[1], part, strlen(part)));
+        }
+    });
+
+    loop.Run();
+    writer.join();
+
+    EXPECT_EQ("hello", received);
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST(EventLoop, RunOnceTimeout) {
+    EventLoop loop;
+
+    const auto start = std::chrono::steady_clock::now();
+    EXPECT_EQ(0u, loop.RunOnce(std::chrono::milliseconds(10)));
+    EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(10));
+
+    loop.Post([] {});
+    EXPECT_EQ(1u, loop.RunOnce(std::chrono::milliseconds(-1)));
+}
+
+class AsyncClientCase : public testing::TestWithParam<ClientOptions> {};
+
+TEST_P(AsyncClientCase, Select) {
+    LoopThread loop;
+    AsyncClient client(loop.Get(), GetParam());
+
+    uint64_t value = 0;
+    auto future = client.Select("SELECT toUInt64(42)", [&value] (const Block& block) {
+        if (block.GetRowCount()) {
+            value = block[0]->As<ColumnUInt64>()->At(0);
+        }
+    });
+
+    future.get();
+    EXPECT_EQ(42u, value);
+}
+
+TEST_P(AsyncClientCase, ServerException) {
+    LoopThread loop;
+    AsyncClient client(loop.Get(), GetParam());
+
+    EXPECT_THROW(client.Execute(Query("SELECT exception")).get(), ServerException);
+
+    // Connection is still usable after an exception.
+    uint64_t value = 0;
+    client.Select("SELECT toUInt64(1)", [&value] (const Block& block) {
+        if (block.GetRowCount()) {
+            value = block[0]->As<ColumnUInt64>()->At(0);
+        }
+    }).get();
+    EXPECT_EQ(1u, value);
+}
+
+TEST_P(AsyncClientCase, Insert) {
+    LoopThread loop;
+    AsyncClient client(loop.Get(), GetParam());
+
+    client.Execute(Query("CREATE TEMPORARY TABLE IF NOT EXISTS test_clickhouse_cpp_async_insert (id UInt64, name String)")).get();
+
+    Block block;
+    auto id = std::make_shared<ColumnUInt64>();
+    auto name = std::make_shared<ColumnString>();
+    for (uint64_t i = 0; i < 1000; ++i) {
+        id->Append(i);
+        name->Append(std::to_string(i));
+    }
+    block.AppendColumn("id", id);
+    block.AppendColumn("name", name);
+
+    client.Insert("test_clickhouse_cpp_async_insert", block).get();
+
+    uint64_t rows = 0;
+    client.Select("SELECT id, name FROM test_clickhouse_cpp_async_insert", [&rows] (const Block& block) {
+        rows += block.GetRowCount();
+    }).get();
+    EXPECT_EQ(1000u, rows);
+}
+
+TEST_P(AsyncClientCase, ManyClientsOnOneLoop) {
+    LoopThread loop;
+
+    const size_t clients_count = 16;
+    const size_t queries_per_client = 8;
+
+    std::vector<std::unique_ptr<AsyncClient>> clients;
+    for (size_t i = 0; i < clients_count; ++i) {
+        clients.push_back(std::make_unique<AsyncClient>(loop.Get(), GetParam()));
+    }
+
+    std::atomic<uint64_t> sum{0};
+    std::atomic<size_t> failures{0};
+    std::promise<void> all_done;
+    std::atomic<size_t> remaining{clients_count * queries_per_client};
+
+    for (size_t i = 0; i < clients_count; ++i) {
+        for (size_t j = 0; j < queries_per_client; ++j) {
+            const uint64_t n = i * queries_per_client + j;
+            clients[i]->Select("SELECT toUInt64(" + std::to_string(n) + ")",
+                [&sum] (const Block& block) {
+                    if (block.GetRowCount()) {
+                        sum += block[0]->As<ColumnUInt64>()->At(0);
+                    }
+                },
+                [&] (std::exception_ptr error) {
+                    if (error) {
+                        ++failures;
+                    }
+                    if (--remaining == 0) {
+                        all_done.set_value();
+                    }
+                });
+        }
+    }
+
+    all_done.get_future().get();
+
+    const uint64_t total = clients_count * queries_per_client;
+    EXPECT_EQ(0u, failures);
+    EXPECT_EQ(total * (total - 1) / 2, sum);
+}
+
+TEST_P(AsyncClientCase, PendingQueriesFailOnDestruction) {
+    LoopThread loop;
+    auto client = std::make_unique<AsyncClient>(loop.Get(), GetParam());
+
+    std::vector<std::future<void>> futures;
+    for (int i = 0; i < 4; ++i) {
+        futures.push_back(client->Execute(Query("SELECT toUInt64(1)")));
+    }
+    client.reset();
+
+    // Every query is either completed or failed, but never left unfinished.
+    for (auto& future : futures) {
+        EXPECT_EQ(std::future_status::ready, future.wait_for(std::chrono::seconds(10)));
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    AsyncClient, AsyncClientCase,
+    ::testing::Values(
+        ClientOptions(LocalHostEndpoint),
+        ClientOptions(LocalHostEndpoint)
+            .SetCompressionMethod(CompressionMethod::LZ4)
+    ));
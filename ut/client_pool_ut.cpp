@@ -0,0 +1,186 @@
+#include <clickhouse/client_pool.h>
+
+#include "utils.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+using namespace clickhouse;
+
+namespace {
+
+const auto LocalHostEndpoint = ClientOptions()
+        .SetHost(           getEnvOrDefault("CLICKHOUSE_HOST",     "localhost"))
+        .SetPort(   getEnvOrDefault<size_t>("CLICKHOUSE_PORT",     "9000"))
+        .SetUser(           getEnvOrDefault("CLICKHOUSE_USER",     "default"))
+        .SetPassword(       getEnvOrDefault("CLICKHOUSE_PASSWORD", ""))
+        .SetDefaultDatabase(getEnvOrDefault("CLICKHOUSE_DB",       "default"));
+
+uint64_t SelectNumber(Client& client, uint64_t n) {
+    uint64_t result = 0;
+    client.Select("SELECT toUInt64(" + std::to_string(n) + ")", [&result] (const Block& block) {
+        if (block.GetRowCount()) {
+            result = block[0]->As<ColumnUInt64>()->At(0);
+        }
+    });
+    return result;
+}
+
+}
+
+TEST(ClientPool, EmptyEndpoints) {
+    EXPECT_THROW(ClientPool{ClientOptions()}, ValidationError);
+    EXPECT_THROW(ClientPool(ClientOptions().SetHost("localhost"), ClientPoolOptions().SetConnectionsPerEndpoint(0)), ValidationError);
+}
+
+TEST(ClientPool, UnreachableEndpoint) {
+    ClientPool pool(ClientOptions()
+            .SetHost("127.0.0.1")
+            .SetPort(1)
+            .SetSendRetries(1)
+            .SetConnectionConnectTimeout(std::chrono::milliseconds(100)),
+        ClientPoolOptions()
+            .SetConnectionsPerEndpoint(1)
+            .SetMaintenanceInterval(std::chrono::milliseconds(10)));
+
+    // Fails with the connection error instead of waiting for the whole timeout.
+    const auto start = std::chrono::steady_clock::now();
+    EXPECT_THROW(pool.Acquire(std::chrono::seconds(30)), std::system_error);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(10));
+
+    const auto status = pool.GetEndpointsStatus();
+    ASSERT_EQ(1u, status.size());
+    EXPECT_EQ("127.0.0.1", status[0].endpoint.host);
+    EXPECT_EQ(1u, status[0].endpoint.port);
+    EXPECT_FALSE(status[0].healthy);
+    EXPECT_GE(status[0].consecutive_failures, 1u);
+    EXPECT_EQ(0u, status[0].idle);
+    EXPECT_EQ(0u, status[0].leased);
+}
+
+class ClientPoolCase : public testing::TestWithParam<ClientOptions> {};
+
+TEST_P(ClientPoolCase, LeaseIsReturned) {
+    ClientPool pool(GetParam(), ClientPoolOptions().SetConnectionsPerEndpoint(1));
+
+    const Client* first = nullptr;
+    {
+        auto lease = pool.Acquire();
+        first = &*lease;
+        EXPECT_EQ(42u, SelectNumber(*lease, 42));
+        EXPECT_EQ(GetParam().port, lease.GetEndpoint().port);
+    }
+
+    {
+        auto lease = pool.Acquire();
+        EXPECT_EQ(first, &*lease);
+
+        const auto status = pool.GetEndpointsStatus();
+        ASSERT_EQ(1u, status.size());
+        EXPECT_TRUE(status[0].healthy);
+        EXPECT_EQ(1u, status[0].leased);
+
+        lease.Release();
+        EXPECT_THROW(lease->Ping(), ValidationError);
+    }
+}
+
+TEST_P(ClientPoolCase, InvalidatedLeaseIsClosed) {
+    ClientPool pool(GetParam(), ClientPoolOptions().SetConnectionsPerEndpoint(1));
+
+    const Client* first = nullptr;
+    {
+        auto lease = pool.Acquire();
+        first = &*lease;
+        lease.Invalidate();
+    }
+
+    auto lease = pool.Acquire();
+    EXPECT_NE(first, &*lease);
+    EXPECT_EQ(1u, SelectNumber(*lease, 1));
+}
+
+TEST_P(ClientPoolCase, LeaseReleasedMidInsertIsClosed) {
+    ClientPool pool(GetParam(), ClientPoolOptions().SetConnectionsPerEndpoint(1));
+
+    const Client* first = nullptr;
+    {
+        auto lease = pool.Acquire();
+        first = &*lease;
+        lease->Execute("CREATE TEMPORARY TABLE IF NOT EXISTS test_clickhouse_cpp_pool_insert (id UInt64)");
+        lease->BeginInsert(Query("INSERT INTO test_clickhouse_cpp_pool_insert (id) VALUES"));
+        lease.Release();
+    }
+
+    const auto status = pool.GetEndpointsStatus();
+    ASSERT_EQ(1u, status.size());
+    EXPECT_EQ(0u, status[0].idle);
+
+    auto lease = pool.Acquire();
+    EXPECT_NE(first, &*lease);
+    EXPECT_EQ(3u, SelectNumber(*lease, 3));
+}
+
+TEST_P(ClientPoolCase, WaitsForFreeConnection) {
+    ClientPool pool(GetParam(), ClientPoolOptions()
+        .SetConnectionsPerEndpoint(1)
+        .SetMaxConnectionsPerEndpoint(1));
+
+    auto lease = pool.Acquire();
+    EXPECT_THROW(pool.Acquire(std::chrono::milliseconds(50)), ProtocolError);
+
+    std::thread releaser([&lease] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        lease.Release();
+    });
+
+    auto other = pool.Acquire(std::chrono::seconds(10));
+    releaser.join();
+    EXPECT_EQ(7u, SelectNumber(*other, 7));
+}
+
+TEST_P(ClientPoolCase, ConcurrentQueries) {
+    ClientPool pool(GetParam(), ClientPoolOptions()
+        .SetConnectionsPerEndpoint(2)
+        .SetMaxConnectionsPerEndpoint(4));
+
+    std::atomic<size_t> failures{0};
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < 8; ++t) {
+        threads.emplace_back([&pool, &failures, t] {
+            for (uint64_t i = 0; i < 20; ++i) {
+                try {
+                    auto lease = pool.Acquire(std::chrono::seconds(30));
+                    if (SelectNumber(*lease, t * 100 + i) != t * 100 + i) {
+                        ++failures;
+                    }
+                } catch (const std::exception&) {
+                    ++failures;
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    EXPECT_EQ(0u, failures);
+
+    const auto status = pool.GetEndpointsStatus();
+    ASSERT_EQ(1u, status.size());
+    EXPECT_EQ(0u, status[0].leased);
+    EXPECT_LE(status[0].idle, 4u);
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    ClientPool, ClientPoolCase,
+    ::testing::Values(
+        ClientOptions(LocalHostEndpoint),
+        ClientOptions(LocalHostEndpoint)
+            .SetCompressionMethod(CompressionMethod::LZ4)
+    ));
@@ -13,10 +13,13 @@
 
 #include <gtest/gtest.h>
 
+#include <atomic>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <ostream>
 #include <string_view>
+#include <system_error>
 #include <thread>
 #include <chrono>
 
@@ -358,6 +361,185 @@ TEST_P(ClientCase, Generic) {
     EXPECT_EQ(sizeof(TEST_DATA)/sizeof(TEST_DATA[0]), row);
 }
 
+TEST_P(ClientCase, InsertMultipleBlocks) {
+    client_->Execute(
+            "CREATE TEMPORARY TABLE IF NOT EXISTS test_clickhouse_cpp_insert_blocks (id UInt64, name String) ");
+
+    // Header of the table is returned rather than passed to the handlers of the query.
+    size_t data_blocks = 0;
+    Query insert("INSERT INTO test_clickhouse_cpp_insert_blocks (id, name) VALUES");
+    insert.OnData([&data_blocks] (const Block&) { ++data_blocks; });
+
+    const Block header = client_->BeginInsert(insert);
+    EXPECT_EQ(0u, data_blocks);
+    ASSERT_EQ(2u, header.GetColumnCount());
+    EXPECT_EQ(0u, header.GetRowCount());
+    EXPECT_EQ("id", header.GetColumnName(0));
+    EXPECT_EQ("name", header.GetColumnName(1));
+    EXPECT_EQ(Type::UInt64, header[0]->Type()->GetCode());
+    EXPECT_EQ(Type::String, header[1]->Type()->GetCode());
+
+    // No other queries are allowed until INSERT is finished.
+    EXPECT_THROW(client_->Execute("SELECT 1"), ValidationError);
+    EXPECT_THROW(client_->BeginInsert("INSERT INTO test_clickhouse_cpp_insert_blocks (id, name) VALUES"), ValidationError);
+
+    const size_t blocks_count = 10;
+    const size_t rows_per_block = 100;
+    for (size_t b = 0; b < blocks_count; ++b) {
+        Block block;
+
+        auto id = std::make_shared<ColumnUInt64>();
+        auto name = std::make_shared<ColumnString>();
+        for (size_t i = 0; i < rows_per_block; ++i) {
+            id->Append(b * rows_per_block + i);
+            name->Append(std::to_string(b * rows_per_block + i));
+        }
+
+        block.AppendColumn("id", id);
+        block.AppendColumn("name", name);
+        block.RefreshRowCount();
+
+        client_->SendInsertBlock(block);
+    }
+    client_->EndInsert();
+
+    EXPECT_THROW(client_->SendInsertBlock(Block()), ValidationError);
+    EXPECT_THROW(client_->EndInsert(), ValidationError);
+
+    size_t row = 0;
+    client_->Select("SELECT id, name FROM test_clickhouse_cpp_insert_blocks ORDER BY id", [&row](const Block& block)
+        {
+            for (size_t c = 0; c < block.GetRowCount(); ++c, ++row) {
+                EXPECT_EQ(row, (*block[0]->As<ColumnUInt64>())[c]);
+                EXPECT_EQ(std::to_string(row), (*block[1]->As<ColumnString>())[c]);
+            }
+        }
+    );
+    EXPECT_EQ(blocks_count * rows_per_block, row);
+}
+
+TEST_P(ClientCase, ColumnProjection) {
+    Query query("SELECT number AS a, toString(number) AS b, [number] AS c FROM system.numbers LIMIT 1000");
+    query.SetColumnProjection({"b"});
+
+    size_t rows = 0;
+    query.OnData([&rows] (const Block& block) {
+        if (block.GetRowCount() == 0) {
+            return;
+        }
+        ASSERT_EQ(1u, block.GetColumnCount());
+        EXPECT_EQ("b", block.GetColumnName(0));
+        auto col = block[0]->As<ColumnString>();
+        for (size_t i = 0; i < block.GetRowCount(); ++i, ++rows) {
+            EXPECT_EQ(std::to_string(rows), col->At(i));
+        }
+    });
+    // Projection applies only to the result, blocks of server logs are passed as they are.
+    size_t log_blocks = 0;
+    query.SetSetting("send_logs_level", {"trace"});
+    query.OnServerLog([&log_blocks] (const Block& block) {
+        EXPECT_LT(1u, block.GetColumnCount());
+        ++log_blocks;
+        return true;
+    });
+    client_->Execute(query);
+
+    EXPECT_EQ(1000u, rows);
+    EXPECT_LT(0u, log_blocks);
+}
+
+TEST_P(ClientCase, KeptBlocksAreIntact) {
+    Query query("SELECT number, toString(number) FROM system.numbers LIMIT 10000");
+    query.SetSetting("max_block_size", QuerySettingsField{"100", 0});
+
+    // Columns of the blocks kept by the handler must not be reused for the next ones.
+    std::vector<Block> blocks;
+    query.OnData([&blocks] (const Block& block) {
+        if (block.GetRowCount()) {
+            blocks.push_back(block);
+        }
+    });
+    client_->Execute(query);
+
+    uint64_t row = 0;
+    for (const auto& block : blocks) {
+        auto numbers = block[0]->As<ColumnUInt64>();
+        auto strings = block[1]->As<ColumnString>();
+        for (size_t i = 0; i < block.GetRowCount(); ++i, ++row) {
+            ASSERT_EQ(row, numbers->At(i));
+            ASSERT_EQ(std::to_string(row), strings->At(i));
+        }
+    }
+    EXPECT_EQ(10000u, row);
+}
+
+TEST_P(ClientCase, SelectCursor) {
+    const uint64_t rows_count = 100000;
+
+    Query query("SELECT number FROM system.numbers LIMIT " + std::to_string(rows_count));
+    query.SetSetting("max_block_size", QuerySettingsField{"1000", 0});
+
+    uint64_t row = 0;
+    {
+        auto cursor = client_->SelectCursor(query, 2);
+
+        // No other queries are allowed until cursor is closed.
+        EXPECT_THROW(client_->Execute("SELECT 1"), ValidationError);
+
+        Block block;
+        while (cursor.Next(block)) {
+            ASSERT_LT(0u, block.GetRowCount());
+            for (size_t c = 0; c < block.GetRowCount(); ++c, ++row) {
+                ASSERT_EQ(row, (*block[0]->As<ColumnUInt64>())[c]);
+            }
+        }
+        EXPECT_FALSE(cursor.Next(block));
+    }
+    EXPECT_EQ(rows_count, row);
+
+    // Client is usable once cursor is closed.
+    size_t rows = 0;
+    client_->Select("SELECT 1", [&rows] (const Block& block) { rows += block.GetRowCount(); });
+    EXPECT_EQ(1u, rows);
+}
+
+TEST_P(ClientCase, SelectCursorCancel) {
+    Query query("SELECT number FROM system.numbers LIMIT 100000000");
+    query.SetSetting("max_block_size", QuerySettingsField{"1000", 0});
+
+    {
+        auto cursor = client_->SelectCursor(query, 1);
+
+        Block block;
+        ASSERT_TRUE(cursor.Next(block));
+        EXPECT_EQ(0u, (*block[0]->As<ColumnUInt64>())[0]);
+        // Cursor is destroyed with the most of data unread.
+    }
+
+    size_t rows = 0;
+    client_->Select("SELECT 1", [&rows] (const Block& block) { rows += block.GetRowCount(); });
+    EXPECT_EQ(1u, rows);
+}
+
+TEST_P(ClientCase, SelectCursorException) {
+    auto cursor = client_->SelectCursor("SELECT unknown_function_for_cursor()");
+
+    Block block;
+    EXPECT_THROW(cursor.Next(block), ServerException);
+}
+
+TEST_P(ClientCase, SelectCursorMovedFrom) {
+    auto cursor = client_->SelectCursor("SELECT 1");
+    auto moved = std::move(cursor);
+
+    Block block;
+    EXPECT_THROW(cursor.Next(block), ValidationError);
+    EXPECT_THROW(cursor.Cancel(), ValidationError);
+
+    ASSERT_TRUE(moved.Next(block));
+    EXPECT_EQ(1u, block.GetRowCount());
+}
+
 TEST_P(ClientCase, Nullable) {
     /// Create a table.
     client_->Execute(
@@ -1220,6 +1402,12 @@ INSTANTIATE_TEST_SUITE_P(
         ClientOptions(LocalHostEndpoint)
             .SetPingBeforeQuery(false)
             .SetCompressionMethod(CompressionMethod::LZ4)
+            .SetRecycleBlocks(true)
+            .SetZeroCopyStrings(true),
+        ClientOptions(LocalHostEndpoint)
+            .SetPingBeforeQuery(true)
+            .SetReceiveAheadBlocks(2)
+            .SetRecycleBlocks(true)
     ));
 
 namespace {
@@ -1489,6 +1677,173 @@ TEST(SimpleClientTest, issue_335_reconnects_count) {
     }
 }
 
+/// Wraps sockets of another factory so that all connections made so far can be broken at once.
+struct BreakingSocketFactory : public SocketFactory {
+
+    class BrokenFlag {
+    public:
+        void Check() const {
+            if (broken) {
+                throw std::system_error(std::make_error_code(std::errc::connection_reset), "connection is broken by test");
+            }
+        }
+
+        std::atomic<bool> broken{false};
+    };
+
+    class Input : public InputStream {
+    public:
+        Input(std::unique_ptr<InputStream> input, std::shared_ptr<BrokenFlag> flag)
+            : input_(std::move(input)), flag_(std::move(flag)) {}
+
+        bool Skip(size_t bytes) override {
+            flag_->Check();
+            return input_->Skip(bytes);
+        }
+
+    protected:
+        size_t DoRead(void* buf, size_t len) override {
+            flag_->Check();
+            return input_->Read(buf, len);
+        }
+
+    private:
+        std::unique_ptr<InputStream> input_;
+        std::shared_ptr<BrokenFlag> flag_;
+    };
+
+    class Output : public OutputStream {
+    public:
+        Output(std::unique_ptr<OutputStream> output, std::shared_ptr<BrokenFlag> flag)
+            : output_(std::move(output)), flag_(std::move(flag)) {}
+
+    protected:
+        void DoFlush() override {
+            flag_->Check();
+            output_->Flush();
+        }
+
+        size_t DoWrite(const void* data, size_t len) override {
+            flag_->Check();
+            return output_->Write(data, len);
+        }
+
+    private:
+        std::unique_ptr<OutputStream> output_;
+        std::shared_ptr<BrokenFlag> flag_;
+    };
+
+    class BreakableSocket : public SocketBase {
+    public:
+        BreakableSocket(std::unique_ptr<SocketBase> socket, std::shared_ptr<BrokenFlag> flag)
+            : socket_(std::move(socket)), flag_(std::move(flag)) {}
+
+        std::unique_ptr<InputStream> makeInputStream() const override {
+            return std::make_unique<Input>(socket_->makeInputStream(), flag_);
+        }
+
+        std::unique_ptr<OutputStream> makeOutputStream() const override {
+            return std::make_unique<Output>(socket_->makeOutputStream(), flag_);
+        }
+
+    private:
+        std::unique_ptr<SocketBase> socket_;
+        std::shared_ptr<BrokenFlag> flag_;
+    };
+
+    std::unique_ptr<SocketBase> connect(const ClientOptions& opts, const Endpoint& endpoint) override {
+        auto flag = std::make_shared<BrokenFlag>();
+        std::lock_guard<std::mutex> lock(mutex);
+        flags.push_back(flag);
+        return std::make_unique<BreakableSocket>(socket_factory.connect(opts, endpoint), flag);
+    }
+
+    void sleepFor(const std::chrono::milliseconds&) override {
+    }
+
+    /// Makes every IO on connections made so far fail, new connections work as usual.
+    void BreakConnections() {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto& flag : flags) {
+            flag->broken = true;
+        }
+    }
+
+    size_t GetConnectRequestsCount() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return flags.size();
+    }
+
+    NonSecureSocketFactory socket_factory;
+    std::mutex mutex;
+    std::vector<std::shared_ptr<BrokenFlag>> flags;
+};
+
+TEST(SimpleClientTest, SelectCursorReconnectsBrokenConnection) {
+    auto socket_factory = std::make_unique<BreakingSocketFactory>();
+    auto* breaker = socket_factory.get();
+
+    Client client(ClientOptions(LocalHostEndpoint)
+                      .SetPingBeforeQuery(true)
+                      .SetSendRetries(1),
+                  std::move(socket_factory));
+    EXPECT_EQ(1u, breaker->GetConnectRequestsCount());
+
+    Query query("SELECT number FROM system.numbers LIMIT 10000000");
+    query.SetSetting("max_block_size", QuerySettingsField{"1000", 0});
+
+    {
+        auto cursor = client.SelectCursor(query, 1);
+
+        Block block;
+        ASSERT_TRUE(cursor.Next(block));
+
+        // Connection is lost while the result is being received.
+        breaker->BreakConnections();
+        EXPECT_THROW(while (cursor.Next(block)) {}, std::system_error);
+    }
+
+    // Ping before the next cursor finds the connection broken and reconnects.
+    uint64_t rows = 0;
+    {
+        auto cursor = client.SelectCursor("SELECT number FROM system.numbers LIMIT 10");
+
+        Block block;
+        while (cursor.Next(block)) {
+            rows += block.GetRowCount();
+        }
+    }
+    EXPECT_EQ(10u, rows);
+    EXPECT_EQ(2u, breaker->GetConnectRequestsCount());
+}
+
+TEST(SimpleClientTest, ReceiveAheadReconnectsBrokenConnection) {
+    auto socket_factory = std::make_unique<BreakingSocketFactory>();
+    auto* breaker = socket_factory.get();
+
+    Client client(ClientOptions(LocalHostEndpoint)
+                      .SetPingBeforeQuery(true)
+                      .SetSendRetries(1)
+                      .SetReceiveAheadBlocks(1),
+                  std::move(socket_factory));
+
+    Query query("SELECT number FROM system.numbers LIMIT 10000000");
+    query.SetSetting("max_block_size", QuerySettingsField{"1000", 0});
+    query.OnData([breaker] (const Block&) {
+        // Connection is lost while the result is being received.
+        breaker->BreakConnections();
+    });
+    EXPECT_THROW(client.Execute(query), std::system_error);
+
+    // Ping before the next query finds the connection broken and reconnects.
+    size_t rows = 0;
+    client.Select("SELECT number FROM system.numbers LIMIT 10", [&rows] (const Block& block) {
+        rows += block.GetRowCount();
+    });
+    EXPECT_EQ(10u, rows);
+    EXPECT_EQ(2u, breaker->GetConnectRequestsCount());
+}
+
 TEST_P(ClientCase, QueryParameters) {
     const auto & server_info = client_->GetServerInfo();
     if (versionNumber(server_info) < versionNumber(24, 7)) {
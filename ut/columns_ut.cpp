@@ -11,9 +11,11 @@
 #include <clickhouse/columns/uuid.h>
 #include <clickhouse/columns/ip4.h>
 #include <clickhouse/columns/ip6.h>
+#include <clickhouse/base/compressed.h>
 #include <clickhouse/base/input.h>
 #include <clickhouse/base/output.h>
 #include <clickhouse/base/socket.h> // for ipv4-ipv6 platform-specific stuff
+#include <clickhouse/exceptions.h>
 
 #include <gtest/gtest.h>
 #include "utils.h"
@@ -137,6 +139,124 @@ TEST(ColumnsCase, StringAppend) {
     ASSERT_EQ(col->At(2), "11");
 }
 
+TEST(ColumnsCase, StringClearReusesBlocks) {
+    auto col = std::make_shared<ColumnString>();
+    const std::string large(100000, 'a');
+    const std::string medium(10000, 'b');
+
+    col->Append(large);
+    const char* large_block = col->At(0).data();
+    col->Append(medium);
+    col->Clear();
+    EXPECT_EQ(0u, col->Size());
+
+    // Any emptied block large enough is reused, not only the last one.
+    const std::string smaller(50000, 'c');
+    col->Append(smaller);
+    EXPECT_EQ(large_block, col->At(0).data());
+    EXPECT_EQ(smaller, col->At(0));
+
+    // Blocks too large to keep are freed and new ones are allocated.
+    const std::string huge(16 << 20, 'd');
+    col->Append(huge);
+    col->Clear();
+    col->Append(huge);
+    EXPECT_EQ(huge, col->At(0));
+}
+
+TEST(ColumnsCase, StringLoadFromSharedBuffers) {
+    std::vector<std::string> values;
+    for (size_t i = 0; i < 1000; ++i) {
+        values.emplace_back(i % 50, static_cast<char>('a' + i % 26));
+    }
+    auto col = std::make_shared<ColumnString>(values);
+
+    Buffer data;
+    {
+        BufferOutput output(&data);
+        // Small chunks, so some of the strings span two of them.
+        auto compressed = std::make_unique<CompressedOutput>(&output, 1000);
+        BufferedOutput buffered(std::move(compressed), 1000);
+        col->Save(&buffered);
+        buffered.Flush();
+    }
+
+    auto loaded = std::make_shared<ColumnString>();
+    {
+        ArrayInput input(data.data(), data.size());
+        CompressedInput compressed(&input, true);
+        ASSERT_TRUE(loaded->Load(&compressed, values.size()));
+    }
+
+    // Values remain valid after the stream is gone.
+    ASSERT_EQ(values.size(), loaded->Size());
+    for (size_t i = 0; i < values.size(); ++i) {
+        EXPECT_EQ(values[i], loaded->At(i));
+    }
+}
+
+TEST(ColumnsCase, StringContiguousStorage) {
+    std::vector<std::string> values;
+    for (size_t i = 0; i < 1000; ++i) {
+        values.emplace_back(i % 200, static_cast<char>('a' + i % 26));
+    }
+
+    auto col = std::make_shared<ColumnString>(ColumnString::Storage::Contiguous);
+    col->Append(values[0]);
+    col->Append(std::string(values[1]));
+    col->AppendNoManagedLifetime(values[2]);
+    col->Append(std::make_shared<ColumnString>(std::vector<std::string>(values.begin() + 3, values.end())));
+
+    // Both buffers are exported as they are.
+    std::string chars;
+    std::vector<uint64_t> offsets;
+    for (const auto& value : values) {
+        chars += value;
+        offsets.push_back(chars.size());
+    }
+    ASSERT_EQ(values.size(), col->Size());
+    EXPECT_EQ(chars, col->Chars());
+    EXPECT_EQ(offsets, col->Offsets());
+    EXPECT_THROW(ColumnString().Chars(), ValidationError);
+
+    Buffer data;
+    {
+        BufferOutput output(&data);
+        // Small chunks, so some of the strings span two of them.
+        auto compressed = std::make_unique<CompressedOutput>(&output, 1000);
+        BufferedOutput buffered(std::move(compressed), 1000);
+        col->Save(&buffered);
+        buffered.Flush();
+    }
+
+    auto loaded = col->CloneEmpty()->As<ColumnString>();
+    {
+        ArrayInput input(data.data(), data.size());
+        CompressedInput compressed(&input, true);
+        ASSERT_TRUE(loaded->Load(&compressed, values.size()));
+    }
+    EXPECT_EQ(ColumnString::Storage::Contiguous, loaded->GetStorage());
+    EXPECT_EQ(chars, loaded->Chars());
+    EXPECT_EQ(offsets, loaded->Offsets());
+
+    // Contiguous values are appended in bulk to a column of either storage.
+    auto slice = loaded->Slice(500, 300)->As<ColumnString>();
+    ASSERT_EQ(300u, slice->Size());
+    EXPECT_EQ(offsets[799] - offsets[499], slice->Offsets().back());
+
+    ColumnString views;
+    views.AppendContiguous(chars.data(), offsets.data(), offsets.size());
+    views.Append(slice);
+    ASSERT_EQ(values.size() + 300, views.Size());
+    for (size_t i = 0; i < values.size(); ++i) {
+        EXPECT_EQ(values[i], views[i]);
+        EXPECT_EQ(values[i], loaded->At(i));
+    }
+    for (size_t i = 0; i < 300; ++i) {
+        EXPECT_EQ(values[500 + i], views[values.size() + i]);
+    }
+}
+
 TEST(ColumnsCase, TupleAppend){
     auto tuple1 = std::make_shared<ColumnTuple>(std::vector<ColumnRef>({
                                 std::make_shared<ColumnUInt64>(),
@@ -0,0 +1,161 @@
+#include <clickhouse/coro.h>
+
+#include "utils.h"
+
+#include <gtest/gtest.h>
+
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+
+using namespace clickhouse;
+
+static_assert(__cpp_impl_coroutine, "coroutine tests must be compiled as C++20");
+
+namespace {
+
+const auto LocalHostEndpoint = ClientOptions()
+        .SetHost(           getEnvOrDefault("CLICKHOUSE_HOST",     "localhost"))
+        .SetPort(   getEnvOrDefault<size_t>("CLICKHOUSE_PORT",     "9000"))
+        .SetUser(           getEnvOrDefault("CLICKHOUSE_USER",     "default"))
+        .SetPassword(       getEnvOrDefault("CLICKHOUSE_PASSWORD", ""))
+        .SetDefaultDatabase(getEnvOrDefault("CLICKHOUSE_DB",       "default"));
+
+/// Runs the loop on a separate thread for the lifetime of the object.
+class LoopThread {
+public:
+    LoopThread()
+        : thread_([this] { loop_.Run(); })
+    {
+    }
+
+    ~LoopThread() {
+        loop_.Stop();
+        thread_.join();
+    }
+
+    EventLoop& Get() {
+        return loop_;
+    }
+
+private:
+    EventLoop loop_;
+    std::thread thread_;
+};
+
+/// Coroutine which starts immediately and is not awaited by anyone.
+struct DetachedTask {
+    struct promise_type {
+        DetachedTask get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+/// Completes the operation on a separate thread, as the loop thread of a client does.
+coro::detail::CompletionAwaitable CompleteOnThread(std::exception_ptr error, coro::Executor executor = {}) {
+    return coro::detail::CompletionAwaitable(
+        [error] (AsyncClient::CompletionCallback cb) {
+            std::thread([error, cb = std::move(cb)] { cb(error); }).detach();
+        },
+        std::move(executor));
+}
+
+DetachedTask AwaitCompletions(std::promise<int>& result) {
+    try {
+        int completed = 0;
+
+        co_await CompleteOnThread(nullptr);
+        ++completed;
+
+        try {
+            co_await CompleteOnThread(std::make_exception_ptr(std::runtime_error("failed")));
+        } catch (const std::runtime_error&) {
+            ++completed;
+        }
+
+        result.set_value(completed);
+    } catch (...) {
+        result.set_exception(std::current_exception());
+    }
+}
+
+DetachedTask AwaitWithExecutor(coro::Executor executor, std::promise<std::thread::id>& result) {
+    co_await CompleteOnThread(nullptr, std::move(executor));
+    result.set_value(std::this_thread::get_id());
+}
+
+DetachedTask RunQueries(AsyncClient& client, std::promise<uint64_t>& result) {
+    try {
+        co_await coro::Execute(client, Query("SELECT toUInt64(1)"));
+
+        bool failed = false;
+        try {
+            co_await coro::Execute(client, Query("SELECT exception"));
+        } catch (const ServerException&) {
+            failed = true;
+        }
+        EXPECT_TRUE(failed);
+
+        uint64_t value = 0;
+        auto stream = coro::Select(client, "SELECT toUInt64(42)");
+        while (auto block = co_await stream.Next()) {
+            if (block->GetRowCount()) {
+                value = (*block)[0]->As<ColumnUInt64>()->At(0);
+            }
+        }
+
+        result.set_value(value);
+    } catch (...) {
+        result.set_exception(std::current_exception());
+    }
+}
+
+}
+
+// Stream shares its state with callbacks of the client, so it can't be left without one.
+static_assert(!std::is_move_constructible_v<coro::BlockStream>);
+static_assert(!std::is_copy_constructible_v<coro::BlockStream>);
+
+TEST(Coroutines, CompletionAwaitable) {
+    std::promise<int> result;
+    AwaitCompletions(result);
+
+    EXPECT_EQ(2, result.get_future().get());
+}
+
+TEST(Coroutines, CompletionAwaitableExecutor) {
+    LoopThread loop;
+    std::promise<std::thread::id> loop_thread;
+    loop.Get().Post([&loop_thread] { loop_thread.set_value(std::this_thread::get_id()); });
+
+    // Coroutine is resumed by the executor rather than on the thread completing the operation.
+    std::promise<std::thread::id> result;
+    AwaitWithExecutor([&loop] (std::coroutine_handle<> handle) { loop.Get().Post([handle] { handle.resume(); }); }, result);
+
+    EXPECT_EQ(loop_thread.get_future().get(), result.get_future().get());
+}
+
+class AsyncClientCoroCase : public testing::TestWithParam<ClientOptions> {};
+
+TEST_P(AsyncClientCoroCase, Queries) {
+    LoopThread loop;
+    AsyncClient client(loop.Get(), GetParam());
+
+    std::promise<uint64_t> result;
+    RunQueries(client, result);
+
+    EXPECT_EQ(42u, result.get_future().get());
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    AsyncClient, AsyncClientCoroCase,
+    ::testing::Values(
+        ClientOptions(LocalHostEndpoint),
+        ClientOptions(LocalHostEndpoint)
+            .SetCompressionMethod(CompressionMethod::LZ4)
+    ));
@@ -13,6 +13,8 @@
 #   include <ws2tcpip.h>
 #else
 #   include <netdb.h>
+#   include <netinet/in.h>
+#   include <unistd.h>
 #endif
 
 using namespace clickhouse;
@@ -113,6 +115,56 @@ TEST(Socketcase, connecttimeout) {
     }
 }
 
+#if defined(_unix_)
+TEST(Socketcase, ZeroCopySend) {
+    const int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addr_len = sizeof(addr);
+    ASSERT_EQ(0, bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)));
+    ASSERT_EQ(0, listen(listen_fd, 1));
+    ASSERT_EQ(0, getsockname(listen_fd, reinterpret_cast<sockaddr*>(&addr), &addr_len));
+
+    std::string received;
+    std::thread server([&] {
+        const int fd = accept(listen_fd, nullptr, nullptr);
+        char buf[65536];
+        ssize_t ret;
+        while ((ret = recv(fd, buf, sizeof(buf), 0)) > 0) {
+            received.append(buf, static_cast<size_t>(ret));
+        }
+        close(fd);
+    });
+
+    std::string data(1024 * 1024, '\0');
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<char>(i % 251);
+    }
+    const std::string expected = "header" + data + "trailer";
+
+    {
+        Socket socket(NetworkAddress("127.0.0.1", std::to_string(ntohs(addr.sin_port))));
+        // Without support of the kernel data is just copied.
+        socket.SetZeroCopySend(64 * 1024);
+
+        BufferedOutput output(socket.makeOutputStream());
+        output.Write("header", 6);
+        output.Write(data.data(), data.size());
+        output.Write("trailer", 7);
+        output.Flush();
+
+        // Kernel has finished with the data after Flush().
+        std::fill(data.begin(), data.end(), 'x');
+    }
+
+    server.join();
+    close(listen_fd);
+
+    EXPECT_TRUE(expected == received);
+}
+#endif
+
 // Test to verify that reading from empty socket doesn't hangs.
 //TEST(Socketcase, ReadFromEmptySocket) {
 //    const int port = 12345;
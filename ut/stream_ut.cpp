@@ -1,9 +1,19 @@
+#include <clickhouse/base/compressed.h>
 #include <clickhouse/base/wire_format.h>
 #include <clickhouse/base/output.h>
 #include <clickhouse/base/input.h>
+#include <clickhouse/base/thread_pool.h>
+#include <clickhouse/base/varint.h>
+#include <clickhouse/exceptions.h>
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <thread>
+
 using namespace clickhouse;
 
 TEST(CodedStreamCase, Varint64) {
@@ -22,3 +32,467 @@ TEST(CodedStreamCase, Varint64) {
         ASSERT_EQ(value, 18446744071965638648ULL);
     }
 }
+
+TEST(VarintCase, StringKernels) {
+    std::vector<std::string> values;
+    for (size_t size : {0, 1, 127, 128, 300, 16383, 16384, 5, 100000}) {
+        values.emplace_back(size, static_cast<char>('a' + size % 26));
+    }
+    const std::vector<std::string_view> items(values.begin(), values.end());
+
+    Buffer expected;
+    {
+        BufferOutput output(&expected);
+        for (const auto& value : values) {
+            WireFormat::WriteString(output, value);
+        }
+    }
+
+    // Only strings lying entirely in the buffer are encoded and decoded.
+    for (size_t len = 0; len <= expected.size(); len += (len < 200 ? 1 : 997)) {
+        Buffer encoded(len);
+        size_t encoded_count = 0;
+        const size_t encoded_len = EncodeStrings(items.data(), items.size(), encoded.data(), len, &encoded_count);
+        encoded.resize(encoded_len);
+
+        std::vector<std::string_view> decoded(items.size());
+        size_t decoded_count = 0;
+        ASSERT_EQ(encoded_len, DecodeStrings(expected.data(), len, decoded.data(), decoded.size(), &decoded_count));
+        ASSERT_EQ(encoded_count, decoded_count);
+        EXPECT_TRUE(std::equal(encoded.begin(), encoded.end(), expected.begin()));
+
+        for (size_t i = 0; i < decoded_count; ++i) {
+            EXPECT_EQ(items[i], decoded[i]);
+        }
+        if (decoded_count < items.size()) {
+            size_t varint_size = 1;
+            for (size_t size = items[decoded_count].size(); size > 0x7F; size >>= 7) {
+                ++varint_size;
+            }
+            EXPECT_LT(len, encoded_len + varint_size + items[decoded_count].size());
+        }
+    }
+
+    // Decoding stops at the requested number of strings.
+    std::vector<std::string_view> decoded(2);
+    size_t decoded_count = 0;
+    EXPECT_EQ(1u + 2u, DecodeStrings(expected.data(), expected.size(), decoded.data(), 2, &decoded_count));
+    EXPECT_EQ(2u, decoded_count);
+}
+
+namespace {
+
+/// Accepts at most 1000 bytes per write, counts gather writes.
+class ChoppingOutput : public OutputStream {
+public:
+    Buffer data;
+    size_t gather_writes = 0;
+
+protected:
+    size_t DoWrite(const void* buf, size_t len) override {
+        len = std::min<size_t>(len, 1000);
+        data.insert(data.end(), static_cast<const uint8_t*>(buf), static_cast<const uint8_t*>(buf) + len);
+        return len;
+    }
+
+    size_t DoWriteV(const OutputChunk* chunks, size_t count) override {
+        ++gather_writes;
+        return OutputStream::DoWriteV(chunks, count);
+    }
+};
+
+}
+
+TEST(BufferedOutputCase, LargeWriteIsGathered) {
+    auto destination = std::make_unique<ChoppingOutput>();
+    auto& sink = *destination;
+
+    Buffer expected;
+    for (size_t i = 0; i < 10000; ++i) {
+        expected.push_back(static_cast<uint8_t>(i * 7));
+    }
+
+    BufferedOutput output(std::move(destination), 1024);
+    WireFormat::WriteBytes(output, expected.data(), 10);
+    WireFormat::WriteBytes(output, expected.data() + 10, expected.size() - 20);
+    // Buffered data is written together with the large piece of data.
+    EXPECT_EQ(expected.size() - 10, sink.data.size());
+    EXPECT_LT(0u, sink.gather_writes);
+
+    WireFormat::WriteBytes(output, expected.data() + expected.size() - 10, 10);
+    output.Flush();
+
+    EXPECT_EQ(expected, sink.data);
+}
+
+TEST(BufferedOutputCase, WriteFittingIntoBufferIsBuffered) {
+    auto destination = std::make_unique<ChoppingOutput>();
+    auto& sink = *destination;
+
+    Buffer expected(900);
+    for (size_t i = 0; i < expected.size(); ++i) {
+        expected[i] = static_cast<uint8_t>(i * 7);
+    }
+
+    // Header and data are written at once, even though the data is large relative to the buffer.
+    BufferedOutput output(std::move(destination), 1024);
+    WireFormat::WriteBytes(output, expected.data(), 10);
+    WireFormat::WriteBytes(output, expected.data() + 10, expected.size() - 10);
+    EXPECT_TRUE(sink.data.empty());
+
+    output.Flush();
+    EXPECT_EQ(expected, sink.data);
+    EXPECT_EQ(0u, sink.gather_writes);
+}
+
+TEST(WireWriterCase, WritesAcrossBuffers) {
+    const auto write_values = [] (auto&& write_varint, auto&& write_fixed, auto&& write_string) {
+        for (uint64_t i = 0; i < 300; ++i) {
+            write_varint(i << (i % 57));
+            write_fixed(static_cast<uint32_t>(i * 31));
+            write_string(std::string(i * i % 3000, 'a' + i % 26));
+        }
+    };
+
+    Buffer expected;
+    {
+        BufferOutput output(&expected);
+        write_values(
+            [&] (uint64_t v) { WireFormat::WriteVarint64(output, v); },
+            [&] (uint32_t v) { WireFormat::WriteFixed(output, v); },
+            [&] (const std::string& v) { WireFormat::WriteString(output, v); });
+    }
+
+    auto destination = std::make_unique<ChoppingOutput>();
+    auto& sink = *destination;
+    BufferedOutput buffered(std::move(destination), 1500);
+    Buffer buffer;
+    {
+        BufferOutput output(&buffer);
+        WireWriter buffered_writer(buffered);
+        WireWriter writer(output);
+        write_values(
+            [&] (uint64_t v) { buffered_writer.WriteVarint64(v); writer.WriteVarint64(v); },
+            [&] (uint32_t v) { buffered_writer.WriteFixed(v); writer.WriteFixed(v); },
+            [&] (const std::string& v) { buffered_writer.WriteString(v); writer.WriteString(v); });
+
+        buffered_writer.Release();
+        WireFormat::WriteString(buffered, "trailer");
+        buffered.Flush();
+    }
+
+    // Space reserved, but not written, is returned to the streams.
+    EXPECT_EQ(expected, buffer);
+    ASSERT_EQ(expected.size() + 8, sink.data.size());
+    EXPECT_TRUE(std::equal(expected.begin(), expected.end(), sink.data.begin()));
+
+    // Values which don't fit into the array are reported by the stream.
+    Buffer small(5);
+    ArrayOutput array(small.data(), small.size());
+    WireWriter writer(array);
+    writer.WriteVarint64(300);
+    writer.WriteFixed<uint16_t>(1);
+    EXPECT_THROW(writer.WriteVarint64(1ULL << 40), ProtocolError);
+}
+
+namespace {
+
+/// Returns at most `chunk` bytes of the data per read.
+class ChunkedInput : public InputStream {
+public:
+    Buffer data;
+    size_t pos = 0;
+    size_t chunk = 0;
+
+protected:
+    bool Skip(size_t) override {
+        return false;
+    }
+
+    size_t DoRead(void* buf, size_t len) override {
+        len = std::min({len, chunk, data.size() - pos});
+        memcpy(buf, data.data() + pos, len);
+        pos += len;
+        return len;
+    }
+};
+
+}
+
+TEST(BufferedInputCase, AdaptiveBufferSize) {
+    auto source = std::make_unique<ChunkedInput>();
+    auto& chunked = *source;
+    for (size_t i = 0; i < 1000000; ++i) {
+        chunked.data.push_back(static_cast<uint8_t>(i * 7));
+    }
+
+    BufferedInput input(std::move(source), 1024, 64 * 1024);
+    Buffer received(chunked.data.size());
+    size_t pos = 0;
+
+    // Source always has more data than the buffer can take.
+    chunked.chunk = chunked.data.size();
+    while (pos < 500000) {
+        ASSERT_TRUE(WireFormat::ReadBytes(input, received.data() + pos, 100));
+        pos += 100;
+    }
+    EXPECT_EQ(64u * 1024, input.BufferSize());
+
+    // Data arrives by small pieces.
+    chunked.chunk = 500;
+    while (pos < 700000) {
+        ASSERT_TRUE(WireFormat::ReadBytes(input, received.data() + pos, 100));
+        pos += 100;
+    }
+    EXPECT_EQ(1024u, input.BufferSize());
+
+    // Another burst.
+    chunked.chunk = chunked.data.size();
+    while (pos < 900000) {
+        ASSERT_TRUE(WireFormat::ReadBytes(input, received.data() + pos, 100));
+        pos += 100;
+    }
+    EXPECT_EQ(64u * 1024, input.BufferSize());
+
+    // Buffer is kept while some of its data is not consumed yet.
+    input.ShrinkIfIdle();
+    EXPECT_EQ(64u * 1024, input.BufferSize());
+
+    // Response ends with the buffered data and no more reads follow, i.e. the connection becomes idle.
+    const void* rest = nullptr;
+    const size_t rest_len = input.Next(&rest, SIZE_MAX);
+    memcpy(received.data() + pos, rest, rest_len);
+    pos += rest_len;
+    input.ShrinkIfIdle();
+    EXPECT_EQ(1024u, input.BufferSize());
+
+    ASSERT_TRUE(WireFormat::ReadBytes(input, received.data() + pos, received.size() - pos));
+    EXPECT_EQ(chunked.data, received);
+}
+
+TEST(WireReaderCase, ReadsAcrossBuffers) {
+    auto source = std::make_unique<ChunkedInput>();
+    auto& chunked = *source;
+    chunked.chunk = 7;
+
+    {
+        BufferOutput output(&chunked.data);
+        for (uint64_t i = 0; i < 300; ++i) {
+            WireFormat::WriteVarint64(output, i << (i % 57));
+            WireFormat::WriteFixed<uint32_t>(output, static_cast<uint32_t>(i * 31));
+            WireFormat::WriteString(output, std::string(i, 'a' + i % 26));
+        }
+        WireFormat::WriteString(output, "trailer");
+        output.Flush();
+    }
+
+    BufferedInput input(std::move(source), 16);
+    {
+        WireReader reader(input);
+        for (uint64_t i = 0; i < 300; ++i) {
+            uint64_t varint = 0;
+            uint32_t fixed = 0;
+            std::string str;
+            ASSERT_TRUE(reader.ReadVarint64(&varint));
+            ASSERT_TRUE(reader.ReadFixed(&fixed));
+            ASSERT_TRUE(reader.ReadString(&str));
+            EXPECT_EQ(i << (i % 57), varint);
+            EXPECT_EQ(i * 31, fixed);
+            EXPECT_EQ(std::string(i, 'a' + i % 26), str);
+        }
+    }
+
+    // Data left in the buffer by the reader is returned to the stream.
+    std::string trailer;
+    ASSERT_TRUE(WireFormat::ReadString(input, &trailer));
+    EXPECT_EQ("trailer", trailer);
+    EXPECT_EQ(chunked.data.size(), chunked.pos);
+}
+
+TEST(CompressedOutputCase, ParallelCompression) {
+    Buffer data;
+    for (size_t i = 0; i < 100000; ++i) {
+        data.push_back(static_cast<uint8_t>((i % 97) * (i % 13)));
+    }
+
+    ThreadPool pool(3);
+    for (auto method : {CompressionMethod::LZ4, CompressionMethod::LZ4HC, CompressionMethod::ZSTD}) {
+        auto compress = [&] (ThreadPool* p) {
+            Buffer result;
+            BufferOutput output(&result);
+            auto compressed = std::make_unique<CompressedOutput>(&output, 1000, method, 0, p);
+            BufferedOutput buffered(std::move(compressed), 1000);
+            // Pieces of different sizes, both buffered and written through.
+            for (size_t pos = 0, piece = 1; pos < data.size(); piece = piece * 3 % 2011) {
+                const size_t len = std::min(piece, data.size() - pos);
+                buffered.Write(data.data() + pos, len);
+                pos += len;
+            }
+            buffered.Flush();
+            return result;
+        };
+
+        for (ThreadPool* p : {static_cast<ThreadPool*>(nullptr), &pool}) {
+            const Buffer result = compress(p);
+
+            Buffer decompressed(data.size());
+            ArrayInput input(result.data(), result.size());
+            CompressedInput compressed(&input);
+            ASSERT_TRUE(WireFormat::ReadBytes(compressed, decompressed.data(), decompressed.size()));
+            EXPECT_EQ(data, decompressed);
+        }
+    }
+}
+
+TEST(CompressedInputCase, ReadsAcrossFrames) {
+    Buffer data;
+    for (size_t i = 0; i < 100000; ++i) {
+        data.push_back(static_cast<uint8_t>((i % 89) * (i % 7)));
+    }
+
+    Buffer compressed_data;
+    {
+        BufferOutput output(&compressed_data);
+        CompressedOutput compressed(&output, 1000, CompressionMethod::ZSTD);
+        compressed.Write(data.data(), data.size());
+        compressed.Flush();
+    }
+    // Something else follows the compressed data, e.g. the next packet.
+    const uint8_t trailer[] = {1, 2, 3};
+    compressed_data.insert(compressed_data.end(), std::begin(trailer), std::end(trailer));
+
+    ThreadPool pool(3);
+    for (ThreadPool* p : {static_cast<ThreadPool*>(nullptr), &pool}) {
+        ArrayInput input(compressed_data.data(), compressed_data.size());
+        Buffer decompressed(data.size());
+        {
+            CompressedInput compressed(&input, false, p);
+            // Reads starting both inside and at the boundary of a frame, some covering whole frames.
+            const size_t reads[] = {10, 990, 25000, 1, 4999, 69000};
+            size_t pos = 0;
+            for (size_t len : reads) {
+                ASSERT_TRUE(WireFormat::ReadBytes(compressed, decompressed.data() + pos, len));
+                pos += len;
+            }
+            ASSERT_EQ(data.size(), pos);
+        }
+
+        EXPECT_EQ(data, decompressed);
+        EXPECT_EQ(sizeof(trailer), input.Avail());
+    }
+}
+
+TEST(CompressedOutputCase, CompressionLevel) {
+    Buffer data;
+    for (size_t i = 0; i < 100000; ++i) {
+        data.push_back(static_cast<uint8_t>((i * i) % 251 < 50 ? i % 7 : i % 11));
+    }
+
+    for (auto method : {CompressionMethod::LZ4HC, CompressionMethod::ZSTD}) {
+        auto compress = [&] (int level) {
+            Buffer result;
+            BufferOutput output(&result);
+            CompressedOutput compressed(&output, 0, method, level);
+            compressed.Write(data.data(), data.size());
+            compressed.Flush();
+            return result;
+        };
+
+        const Buffer fast = compress(1);
+        const Buffer strong = compress(12);
+        EXPECT_LE(strong.size(), fast.size());
+
+        Buffer decompressed(data.size());
+        ArrayInput input(strong.data(), strong.size());
+        CompressedInput compressed(&input);
+        ASSERT_TRUE(WireFormat::ReadBytes(compressed, decompressed.data(), decompressed.size()));
+        EXPECT_EQ(data, decompressed);
+    }
+}
+
+namespace {
+
+/// Takes a microsecond per 10 bytes, like a slow link.
+class SlowOutput : public OutputStream {
+public:
+    Buffer data;
+
+protected:
+    size_t DoWrite(const void* buf, size_t len) override {
+        std::this_thread::sleep_for(std::chrono::microseconds(len / 10));
+        data.insert(data.end(), static_cast<const uint8_t*>(buf), static_cast<const uint8_t*>(buf) + len);
+        return len;
+    }
+};
+
+}
+
+TEST(CompressedOutputCase, AdaptiveCompression) {
+    // Compressible and random halves, so different methods suit them.
+    Buffer data(200000);
+    for (size_t i = 0; i < data.size() / 2; ++i) {
+        data[i] = static_cast<uint8_t>(i % 10);
+    }
+    uint32_t random = 12345;
+    for (size_t i = data.size() / 2; i < data.size(); ++i) {
+        random = random * 1103515245 + 12345;
+        data[i] = static_cast<uint8_t>(random >> 16);
+    }
+
+    AdaptiveCompressionStats stats;
+    SlowOutput output;
+    {
+        CompressedOutput compressed(&output, 1000, CompressionMethod::Adaptive, 0, nullptr, nullptr, &stats);
+        compressed.Write(data.data(), data.size());
+        compressed.Flush();
+    }
+    // Compressible data is compressed, while random one is not sent larger than it is.
+    EXPECT_LT(output.data.size(), data.size() * 6 / 10);
+
+    Buffer decompressed(data.size());
+    ArrayInput input(output.data.data(), output.data.size());
+    CompressedInput compressed(&input);
+    ASSERT_TRUE(WireFormat::ReadBytes(compressed, decompressed.data(), decompressed.size()));
+    EXPECT_EQ(data, decompressed);
+}
+
+TEST(CompressedOutputCase, ZstdDictionary) {
+    // Small chunks of alike records.
+    auto make_chunk = [] (size_t n) {
+        std::string chunk;
+        for (size_t i = 0; chunk.size() < 1000; ++i) {
+            chunk += "host-" + std::to_string((n * 7 + i) % 13) + ".example.com\tGET\t/api/v1/items/"
+                   + std::to_string(n * 1000 + i) + "\tstatus=200\n";
+        }
+        return Buffer(chunk.begin(), chunk.end());
+    };
+
+    std::vector<Buffer> samples;
+    for (size_t n = 0; n < 200; ++n) {
+        samples.push_back(make_chunk(n));
+    }
+    const auto trained = ZstdDictionary::Train(samples, 16 * 1024);
+    // As if it was stored along with the data.
+    const auto dictionary = ZstdDictionary::Load(trained->Data());
+
+    const Buffer data = make_chunk(1000);
+    auto compress = [&] (std::shared_ptr<const ZstdDictionary> dict) {
+        Buffer result;
+        BufferOutput output(&result);
+        CompressedOutput compressed(&output, 0, CompressionMethod::ZSTD);
+        compressed.SetDictionary(dict);
+        compressed.Write(data.data(), data.size());
+        compressed.Flush();
+        return result;
+    };
+
+    const Buffer with_dictionary = compress(trained);
+    EXPECT_LT(with_dictionary.size(), compress(nullptr).size());
+
+    Buffer decompressed(data.size());
+    ArrayInput input(with_dictionary.data(), with_dictionary.size());
+    CompressedInput compressed(&input);
+    compressed.SetDictionary(dictionary);
+    ASSERT_TRUE(WireFormat::ReadBytes(compressed, decompressed.data(), decompressed.size()));
+    EXPECT_EQ(data, decompressed);
+}
@@ -1,6 +1,10 @@
 #include <clickhouse/types/type_parser.h>
 #include <gtest/gtest.h>
 
+#include <atomic>
+#include <thread>
+#include <vector>
+
 using namespace clickhouse;
 
 // TODO: add tests for Decimal column types.
@@ -259,6 +263,41 @@ TEST(ParseTypeName, EmptyName) {
     EXPECT_EQ(nullptr, ParseTypeName(std::string(5, '\0')));
 }
 
+TEST(ParseTypeName, Cached) {
+    const auto ast = ParseTypeName("Array(Nullable(String))");
+    ASSERT_NE(nullptr, ast);
+    EXPECT_EQ(ast, ParseTypeName("Array(Nullable(String))"));
+
+    // Evicted ASTs stay valid for their owners, names are parsed again on demand.
+    for (int i = 0; i < 10000; ++i) {
+        ASSERT_NE(nullptr, ParseTypeName("FixedString(" + std::to_string(i + 1) + ")"));
+    }
+    EXPECT_EQ(TypeAst::Array, ast->meta);
+    EXPECT_EQ(*ast, *ParseTypeName("Array(Nullable(String))"));
+}
+
+TEST(ParseTypeName, ConcurrentAccess) {
+    std::vector<std::thread> threads;
+    std::atomic<size_t> failures{0};
+
+    for (int t = 0; t < 8; ++t) {
+        threads.emplace_back([&failures] {
+            for (int i = 0; i < 1000; ++i) {
+                const auto name = "Decimal(18, " + std::to_string(i % 18) + ")";
+                const auto ast = ParseTypeName(name);
+                if (!ast || ast->elements.size() != 2 || ast->elements[1].value != i % 18) {
+                    ++failures;
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    EXPECT_EQ(0u, failures);
+}
+
 TEST(TypeParser, AggregateFunction) {
     {
         TypeAst ast;
@@ -0,0 +1,241 @@
+#include <clickhouse/base/uring_socket.h>
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace clickhouse;
+
+namespace {
+
+/// Accepts one connection on the loopback and runs the handler with its descriptor.
+class LoopbackServer {
+public:
+    explicit LoopbackServer(std::function<void(int)> handler) {
+        listen_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = 0;
+        EXPECT_EQ(0, bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)));
+        EXPECT_EQ(0, listen(listen_fd_, 1));
+
+        socklen_t len = sizeof(addr);
+        EXPECT_EQ(0, getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&addr), &len));
+        port_ = ntohs(addr.sin_port);
+
+        thread_ = std::thread([this, handler = std::move(handler)] {
+            const int fd = accept(listen_fd_, nullptr, nullptr);
+            if (fd >= 0) {
+                handler(fd);
+                close(fd);
+            }
+        });
+    }
+
+    ~LoopbackServer() {
+        thread_.join();
+        close(listen_fd_);
+    }
+
+    NetworkAddress Address() const {
+        return NetworkAddress("127.0.0.1", std::to_string(port_));
+    }
+
+private:
+    int listen_fd_ = -1;
+    int port_ = 0;
+    std::thread thread_;
+};
+
+std::string ReadExactly(int fd, size_t size) {
+    std::string result(size, '\0');
+    size_t pos = 0;
+    while (pos < size) {
+        const ssize_t ret = recv(fd, &result[pos], size - pos, 0);
+        if (ret <= 0) {
+            break;
+        }
+        pos += static_cast<size_t>(ret);
+    }
+    result.resize(pos);
+    return result;
+}
+
+void WriteAll(int fd, const std::string& data) {
+    size_t pos = 0;
+    while (pos < data.size()) {
+        const ssize_t ret = send(fd, data.data() + pos, data.size() - pos, MSG_NOSIGNAL);
+        if (ret <= 0) {
+            break;
+        }
+        pos += static_cast<size_t>(ret);
+    }
+}
+
+std::string MakeData(size_t size, char seed) {
+    std::string data(size, '\0');
+    for (size_t i = 0; i < size; ++i) {
+        data[i] = static_cast<char>(seed + i % 251);
+    }
+    return data;
+}
+
+/// Writes all data of the chunks, resubmitting the rest of them after a partial write.
+size_t WriteChunks(OutputStream& output, const OutputChunk* chunks, size_t count) {
+    size_t written = 0;
+    while (true) {
+        std::vector<OutputChunk> rest;
+        size_t skip = written;
+        for (size_t i = 0; i < count; ++i) {
+            if (skip >= chunks[i].len) {
+                skip -= chunks[i].len;
+                continue;
+            }
+            rest.push_back({static_cast<const char*>(chunks[i].data) + skip, chunks[i].len - skip});
+            skip = 0;
+        }
+        if (rest.empty()) {
+            return written;
+        }
+
+        const size_t ret = output.WriteV(rest.data(), rest.size());
+        if (ret == 0) {
+            return written;
+        }
+        written += ret;
+    }
+}
+
+}
+
+TEST(UringSocketCase, GatherWriteAndReceive) {
+    // Larger than the registered buffers, so they are recycled while reading.
+    const std::string first = MakeData(700 * 1024, 'a');
+    const std::string second = MakeData(5, 'x');
+    const std::string third = MakeData(300 * 1024, '0');
+    const std::string expected = first + second + third;
+
+    LoopbackServer server([&] (int fd) {
+        WriteAll(fd, ReadExactly(fd, expected.size()));
+    });
+
+    UringSocket socket(server.Address(), SocketTimeoutParams{});
+    auto output = socket.makeOutputStream();
+    auto input = socket.makeInputStream();
+
+    const OutputChunk chunks[] = {
+        {first.data(), first.size()},
+        {second.data(), second.size()},
+        {third.data(), third.size()},
+    };
+    ASSERT_EQ(expected.size(), WriteChunks(*output, chunks, 3));
+
+    std::string received(expected.size(), '\0');
+    size_t pos = 0;
+    while (pos < received.size()) {
+        // Small reads take data out of a registered buffer in several steps.
+        const size_t ret = input->Read(&received[pos], std::min<size_t>(received.size() - pos, 10000));
+        ASSERT_GT(ret, 0u);
+        pos += ret;
+    }
+    EXPECT_TRUE(expected == received);
+}
+
+TEST(UringSocketCase, GatherWriteWithShortSends) {
+    // Small chunks between large ones, like buffered headers between column bodies.
+    std::vector<std::string> parts;
+    for (size_t i = 0; i < 8; ++i) {
+        parts.push_back(MakeData(7, static_cast<char>('a' + i)));
+        parts.push_back(MakeData(200 * 1024 + i, static_cast<char>('0' + i)));
+    }
+    std::string expected;
+    std::vector<OutputChunk> chunks;
+    for (const auto& part : parts) {
+        expected += part;
+        chunks.push_back({part.data(), part.size()});
+    }
+
+    std::string received;
+    {
+        LoopbackServer server([&] (int fd) {
+            // Slow reader keeps the send buffer of the client nearly full, so sends are short.
+            while (received.size() < expected.size()) {
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+                const std::string chunk = ReadExactly(fd, std::min<size_t>(4096, expected.size() - received.size()));
+                if (chunk.empty()) {
+                    break;
+                }
+                received += chunk;
+            }
+        });
+
+        UringSocket socket(server.Address(), SocketTimeoutParams{});
+        const int sndbuf = 4096;
+        ASSERT_EQ(0, setsockopt(socket.GetHandle(), SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf)));
+
+        auto output = socket.makeOutputStream();
+        ASSERT_EQ(expected.size(), WriteChunks(*output, chunks.data(), chunks.size()));
+    }
+
+    // Rest of a chunk sent partially goes before the next chunk.
+    EXPECT_TRUE(expected == received);
+}
+
+TEST(UringSocketCase, ReceiveTimeout) {
+    using Clock = std::chrono::steady_clock;
+
+    LoopbackServer server([] (int fd) {
+        // Waits for the client to give up.
+        char buf[1];
+        recv(fd, buf, sizeof(buf), 0);
+    });
+
+    const std::chrono::milliseconds timeout(200);
+    UringSocket socket(server.Address(), SocketTimeoutParams{std::chrono::seconds(5), timeout, timeout});
+    auto input = socket.makeInputStream();
+
+    const auto start = Clock::now();
+    char buf[16];
+    try {
+        input->Read(buf, sizeof(buf));
+        FAIL();
+    } catch (const std::system_error& e) {
+        EXPECT_EQ(EAGAIN, e.code().value());
+    }
+    EXPECT_GE(Clock::now() - start, timeout);
+
+    // Socket is still usable after the timeout.
+    const char byte = 1;
+    EXPECT_EQ(1u, socket.makeOutputStream()->Write(&byte, 1));
+}
+
+TEST(UringSocketCase, PeerClosed) {
+    LoopbackServer server([] (int fd) {
+        WriteAll(fd, "abc");
+    });
+
+    UringSocket socket(server.Address(), SocketTimeoutParams{});
+    auto input = socket.makeInputStream();
+
+    std::string received;
+    char buf[16];
+    try {
+        while (true) {
+            const size_t ret = input->Read(buf, sizeof(buf));
+            received.append(buf, ret);
+        }
+    } catch (const std::system_error&) {
+    }
+    EXPECT_EQ("abc", received);
+}